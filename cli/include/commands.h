@@ -0,0 +1,40 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <stdint.h>
+
+#include "neuralnetwork.h"
+
+typedef struct options {
+    const char *topology;
+    double learning_rate;
+    uint32_t number_of_epochs;
+    LearningRateSchedule schedule;
+    double decay_rate;
+    double minimum_learning_rate;
+    uint32_t warmup_examples;
+    uint32_t schedule_every_examples;
+    uint32_t number_of_validation_examples;
+    uint32_t patience;
+    uint64_t seed;
+    const char *checkpoint_filename;
+
+    // Augmentation of the training images, disabled when all are 0
+    double max_shift;
+    double max_rotation;
+    double max_scale;
+    double noise;
+
+    int threads;
+    uint32_t batch_size;
+    uint32_t top_k;
+    WeightPrecision precision;
+    const char *autotune_cache;
+} Options;
+
+Options options_default(void);
+
+void command_train(const char *directory, const char *model_filename, Options *options);
+void command_test(const char *directory, const char *model_filename, Options *options);
+
+#endif  // COMMANDS_H
@@ -0,0 +1,231 @@
+#include <errno.h>
+#include <getopt.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "commands.h"
+#include "neuralnetwork.h"
+
+static const struct option long_options[] = {
+    {"topology", required_argument, NULL, 't'},
+    {"learning-rate", required_argument, NULL, 'r'},
+    {"epochs", required_argument, NULL, 'e'},
+    {"schedule", required_argument, NULL, 's'},
+    {"decay-rate", required_argument, NULL, 'd'},
+    {"minimum-learning-rate", required_argument, NULL, 'm'},
+    {"warmup", required_argument, NULL, 'w'},
+    {"schedule-every", required_argument, NULL, 'u'},
+    {"validation", required_argument, NULL, 'v'},
+    {"patience", required_argument, NULL, 'p'},
+    {"seed", required_argument, NULL, 'S'},
+    {"checkpoint", required_argument, NULL, 'c'},
+    {"shift", required_argument, NULL, 'x'},
+    {"rotation", required_argument, NULL, 'o'},
+    {"scale", required_argument, NULL, 'z'},
+    {"noise", required_argument, NULL, 'n'},
+    {"threads", required_argument, NULL, 'j'},
+    {"batch-size", required_argument, NULL, 'b'},
+    {"top-k", required_argument, NULL, 'k'},
+    {"precision", required_argument, NULL, 'P'},
+    {"autotune", required_argument, NULL, 'a'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0},
+};
+
+static void usage(const char *program, FILE *file) {
+    fprintf(
+        file,
+        "Usage: %s train|test DATA_DIRECTORY MODEL [OPTIONS]\n"
+        "   DATA_DIRECTORY holds the IDX files {train,test}-images.bin and {train,test}-labels.bin\n"
+        "   train: trains a network on the train set, saves it to MODEL, and evaluates it on the test set if any\n"
+        "   test: evaluates the network saved in MODEL on the test set\n"
+        "Options:\n"
+        "   -t, --topology SPEC       hidden layers as SIZE[:ACTIVATION],... (sigmoid or linear), default 89;\n"
+        "                             the softmax output layer has one neuron per class\n"
+        "   -r, --learning-rate RATE  default 0.1\n"
+        "   -e, --epochs N            default 5\n"
+        "   -s, --schedule NAME       constant, step, exponential, cosine or plateau, default constant\n"
+        "   -d, --decay-rate RATE     decay of the step, exponential and plateau schedules, default 0.5\n"
+        "   -m, --minimum-learning-rate RATE\n"
+        "                             floor of the cosine schedule, default 0.001\n"
+        "   -w, --warmup N            examples of linear learning rate warmup, default 0\n"
+        "   -u, --schedule-every N    update the learning rate every N examples, default every epoch\n"
+        "   -v, --validation N        last training examples held out for validation, default 5000\n"
+        "   -p, --patience N          epochs without validation improvement before stopping, default 2\n"
+        "   -S, --seed N              weights initialization and augmentation seed, default 42\n"
+        "   -c, --checkpoint FILE     checkpoint every epoch to FILE, and resume from it if it exists\n"
+        "   -x, --shift PIXELS        augmentation: random shift of the square images, default 0\n"
+        "   -o, --rotation DEGREES    augmentation: random rotation, default 0\n"
+        "   -z, --scale RATIO         augmentation: random scaling, e.g. 0.1 for [0.9, 1.1], default 0\n"
+        "   -n, --noise STDDEV        augmentation: gaussian noise on the [0, 1] scale, default 0\n"
+        "   -j, --threads N           number of threads, default all\n"
+        "   -b, --batch-size N        samples per tile of the batched forward, default autotuned or %d\n"
+        "   -k, --top-k N             default 3\n"
+        "   -P, --precision NAME      weights for the evaluation: double, bfloat16 or float16, default double\n"
+        "   -a, --autotune CACHE      autotune the kernels within the -j threads, caching the plans in CACHE\n"
+        "   -h, --help\n",
+        program,
+        FORWARD_TILE_SIZE);
+}
+
+static uint32_t parse_uint32(const char *text, const char *name) {
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value > UINT32_MAX) {
+        fprintf(stderr, "ERROR: Invalid %s: '%s'\n", name, text);
+        exit(EXIT_FAILURE);
+    }
+    return (uint32_t)value;
+}
+
+static uint64_t parse_uint64(const char *text, const char *name) {
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (*text == '\0' || *text == '-' || *end != '\0' || errno == ERANGE) {
+        fprintf(stderr, "ERROR: Invalid %s: '%s'\n", name, text);
+        exit(EXIT_FAILURE);
+    }
+    return (uint64_t)value;
+}
+
+static double parse_double(const char *text, const char *name) {
+    char *end;
+    double value = strtod(text, &end);
+    if (*text == '\0' || *end != '\0') {
+        fprintf(stderr, "ERROR: Invalid %s: '%s'\n", name, text);
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+static LearningRateSchedule parse_schedule(const char *name) {
+    const char *names[] = {"constant", "step", "exponential", "cosine", "plateau"};
+    const LearningRateSchedule schedules[] = {CONSTANT_SCHEDULE, STEP_SCHEDULE, EXPONENTIAL_SCHEDULE, COSINE_SCHEDULE, PLATEAU_SCHEDULE};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return schedules[i];
+        }
+    }
+    fprintf(stderr, "ERROR: Unknown learning rate schedule: '%s'\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static WeightPrecision parse_precision(const char *name) {
+    const char *names[] = {"double", "bfloat16", "float16"};
+    const WeightPrecision precisions[] = {DOUBLE_PRECISION, BFLOAT16_PRECISION, FLOAT16_PRECISION};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return precisions[i];
+        }
+    }
+    fprintf(stderr, "ERROR: Unknown weights precision: '%s'\n", name);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv) {
+    Options options = options_default();
+
+    int option;
+    while ((option = getopt_long(argc, argv, "t:r:e:s:d:m:w:u:v:p:S:c:x:o:z:n:j:b:k:P:a:h", long_options, NULL)) != -1) {
+        switch (option) {
+            case 't':
+                options.topology = optarg;
+                break;
+            case 'r':
+                options.learning_rate = parse_double(optarg, "learning rate");
+                break;
+            case 'e':
+                options.number_of_epochs = parse_uint32(optarg, "number of epochs");
+                break;
+            case 's':
+                options.schedule = parse_schedule(optarg);
+                break;
+            case 'd':
+                options.decay_rate = parse_double(optarg, "decay rate");
+                break;
+            case 'm':
+                options.minimum_learning_rate = parse_double(optarg, "minimum learning rate");
+                break;
+            case 'w':
+                options.warmup_examples = parse_uint32(optarg, "number of warmup examples");
+                break;
+            case 'u':
+                options.schedule_every_examples = parse_uint32(optarg, "number of examples between learning rate updates");
+                break;
+            case 'v':
+                options.number_of_validation_examples = parse_uint32(optarg, "number of validation examples");
+                break;
+            case 'p':
+                options.patience = parse_uint32(optarg, "patience");
+                break;
+            case 'S':
+                options.seed = parse_uint64(optarg, "seed");
+                break;
+            case 'c':
+                options.checkpoint_filename = optarg;
+                break;
+            case 'x':
+                options.max_shift = parse_double(optarg, "shift");
+                break;
+            case 'o':
+                options.max_rotation = parse_double(optarg, "rotation");
+                break;
+            case 'z':
+                options.max_scale = parse_double(optarg, "scale");
+                break;
+            case 'n':
+                options.noise = parse_double(optarg, "noise");
+                break;
+            case 'j':
+                options.threads = (int)parse_uint32(optarg, "number of threads");
+                break;
+            case 'b':
+                options.batch_size = parse_uint32(optarg, "batch size");
+                break;
+            case 'k':
+                options.top_k = parse_uint32(optarg, "top-k");
+                break;
+            case 'P':
+                options.precision = parse_precision(optarg);
+                break;
+            case 'a':
+                options.autotune_cache = optarg;
+                break;
+            case 'h':
+                usage(argv[0], stdout);
+                return EXIT_SUCCESS;
+            default:
+                usage(argv[0], stderr);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc - optind != 3) {
+        usage(argv[0], stderr);
+        exit(EXIT_FAILURE);
+    }
+    const char *command = argv[optind];
+    const char *directory = argv[optind + 1];
+    const char *model_filename = argv[optind + 2];
+
+    // Before any autotuning, whose plans stay within this limit
+    if (options.threads > 0) {
+        omp_set_num_threads(options.threads);
+    }
+
+    if (strcmp(command, "train") == 0) {
+        command_train(directory, model_filename, &options);
+    } else if (strcmp(command, "test") == 0) {
+        command_test(directory, model_filename, &options);
+    } else {
+        fprintf(stderr, "ERROR: Unknown command: '%s'\n", command);
+        usage(argv[0], stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,254 @@
+#include "commands.h"
+
+#include <math.h>
+#include <omp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "augmentation.h"
+#include "data.h"
+#include "evaluation.h"
+#include "memory.h"
+#include "tuning.h"
+
+#define MAX_HIDDEN_LAYERS 16
+#define MAX_PATH_LENGTH 1024
+
+Options options_default(void) {
+    Options options = {
+        .topology = "89",
+        .learning_rate = 0.1,
+        .number_of_epochs = 5,
+        .schedule = CONSTANT_SCHEDULE,
+        .decay_rate = 0.5,
+        .minimum_learning_rate = 0.001,
+        .warmup_examples = 0,
+        .schedule_every_examples = 0,
+        .number_of_validation_examples = 5000,
+        .patience = 2,
+        .seed = 42,
+        .checkpoint_filename = NULL,
+        .max_shift = 0.0,
+        .max_rotation = 0.0,
+        .max_scale = 0.0,
+        .noise = 0.0,
+        .threads = 0,
+        .batch_size = 0,
+        .top_k = 3,
+        .precision = DOUBLE_PRECISION,
+        .autotune_cache = NULL,
+    };
+    return options;
+}
+
+// Hidden layers as SIZE[:ACTIVATION] separated by commas, e.g. "128,64:linear"
+static uint16_t parse_topology(const char *specification, uint32_t *sizes, ActivationFunction *activations) {
+    uint16_t number_of_layers = 0;
+    const char *layer = specification;
+    while (*layer != '\0') {
+        if (number_of_layers == MAX_HIDDEN_LAYERS) {
+            fprintf(stderr, "ERROR: At most %d hidden layers are supported\n", MAX_HIDDEN_LAYERS);
+            exit(EXIT_FAILURE);
+        }
+
+        char *end;
+        unsigned long size = strtoul(layer, &end, 10);
+        if (end == layer || size == 0 || size > UINT32_MAX) {
+            fprintf(stderr, "ERROR: Invalid topology: '%s'\n", specification);
+            exit(EXIT_FAILURE);
+        }
+        sizes[number_of_layers] = (uint32_t)size;
+        activations[number_of_layers] = SIGMOID_ACTIVATION;
+
+        if (*end == ':') {
+            const char *activation = end + 1;
+            size_t length = strcspn(activation, ",");
+            if (length == strlen("sigmoid") && strncmp(activation, "sigmoid", length) == 0) {
+                activations[number_of_layers] = SIGMOID_ACTIVATION;
+            } else if (length == strlen("linear") && strncmp(activation, "linear", length) == 0) {
+                activations[number_of_layers] = LINEAR_ACTIVATION;
+            } else {
+                fprintf(stderr, "ERROR: Unsupported hidden layer activation in topology: '%s'\n", specification);
+                exit(EXIT_FAILURE);
+            }
+            end = (char *)activation + length;
+        }
+        if (*end != ',' && *end != '\0') {
+            fprintf(stderr, "ERROR: Invalid topology: '%s'\n", specification);
+            exit(EXIT_FAILURE);
+        }
+
+        number_of_layers += 1;
+        layer = (*end == ',') ? end + 1 : end;
+    }
+    return number_of_layers;
+}
+
+static bool dataset_exists(const char *directory, const char *name) {
+    char images_filename[MAX_PATH_LENGTH], labels_filename[MAX_PATH_LENGTH];
+    snprintf(images_filename, MAX_PATH_LENGTH, "%s/%s-images.bin", directory, name);
+    snprintf(labels_filename, MAX_PATH_LENGTH, "%s/%s-labels.bin", directory, name);
+    return access(images_filename, R_OK) == 0 && access(labels_filename, R_OK) == 0;
+}
+
+static bool augmenting(Options *options) {
+    return options->max_shift > 0.0 || options->max_rotation > 0.0 || options->max_scale > 0.0 || options->noise > 0.0;
+}
+
+static NeuralNetwork create_network(Options *options, uint32_t input_size, uint32_t output_size) {
+    uint32_t hidden_sizes[MAX_HIDDEN_LAYERS];
+    ActivationFunction hidden_activations[MAX_HIDDEN_LAYERS];
+    uint16_t number_of_hidden_layers = parse_topology(options->topology, hidden_sizes, hidden_activations);
+
+    NeuralNetwork network = neuralnetwork_create(number_of_hidden_layers + 1);
+    for (uint16_t i = 0; i < number_of_hidden_layers; i++) {
+        neuralnetwork_add_layer(&network, input_size, hidden_activations[i], hidden_sizes[i]);
+        input_size = hidden_sizes[i];
+    }
+    neuralnetwork_add_layer(&network, input_size, SOFTMAX_ACTIVATION, output_size);
+    neuralnetwork_initialize(&network, XAVIER_INITIALIZATION, options->seed);
+    return network;
+}
+
+static void prepare_network(NeuralNetwork *network, Options *options) {
+    if (options->autotune_cache) {
+        neuralnetwork_autotune(network, options->autotune_cache);
+    }
+    // An explicit batch size overrides the autotuned one
+    if (options->batch_size > 0) {
+        network->tile_size = options->batch_size;
+    }
+}
+
+static void evaluate(NeuralNetwork *network, const char *directory, Options *options) {
+    Dataset test = dataset_load(directory, "test");
+    if (test.image_size != neuralnetwork_input_size(network)) {
+        fprintf(stderr, "ERROR: The test images don't match the input size of the network (%d, expected %d)\n", test.image_size, neuralnetwork_input_size(network));
+        exit(EXIT_FAILURE);
+    }
+
+    neuralnetwork_replicate(network);
+    neuralnetwork_set_precision(network, options->precision);
+    Evaluation evaluation = neuralnetwork_evaluate(network, test.images, test.labels, test.number_of_images, options->top_k);
+    evaluation_print(&evaluation, stdout);
+
+    // Same model with 16-bit weights, as used for low-precision inference
+    if (options->precision == DOUBLE_PRECISION) {
+        const WeightPrecision precisions[] = {BFLOAT16_PRECISION, FLOAT16_PRECISION};
+        const char *precision_names[] = {"bfloat16", "float16"};
+        printf("   Accuracy with 16-bit weights:\n");
+        for (size_t i = 0; i < sizeof(precisions) / sizeof(precisions[0]); i++) {
+            neuralnetwork_set_precision(network, precisions[i]);
+            double accuracy = neuralnetwork_benchmark(network, test.images, test.labels, test.number_of_images);
+            printf("      %s: %.3f%% (%+.3f%%)\n", precision_names[i], accuracy * 100, (accuracy - evaluation.accuracy) * 100);
+        }
+        neuralnetwork_set_precision(network, DOUBLE_PRECISION);
+    }
+
+    evaluation_destroy(&evaluation);
+    dataset_destroy(&test);
+}
+
+void command_train(const char *directory, const char *model_filename, Options *options) {
+    Dataset train = dataset_load(directory, "train");
+    if (train.number_of_images <= options->number_of_validation_examples) {
+        fprintf(stderr, "ERROR: Not enough training images (%d) for %d validation examples\n", train.number_of_images, options->number_of_validation_examples);
+        exit(EXIT_FAILURE);
+    }
+
+    // Fresh random shifts, rotations, scalings and noise of the square training images every epoch
+    Augmentation augmentation = {0};
+    if (augmenting(options)) {
+        char images_filename[MAX_PATH_LENGTH];
+        snprintf(images_filename, MAX_PATH_LENGTH, "%s/train-images.bin", directory);
+        uint32_t number_of_images, image_size;
+        augmentation.images = load_images(images_filename, 1, &number_of_images, &image_size);
+        augmentation.width = (uint32_t)lround(sqrt((double)image_size));
+        augmentation.height = augmentation.width;
+        if (augmentation.width * augmentation.height != image_size) {
+            fprintf(stderr, "ERROR: Only square images can be augmented (%d pixels)\n", image_size);
+            exit(EXIT_FAILURE);
+        }
+        augmentation.seed = options->seed;
+        augmentation.max_shift = options->max_shift;
+        augmentation.max_rotation = options->max_rotation;
+        augmentation.max_scale = options->max_scale;
+        augmentation.noise = options->noise;
+    }
+
+    uint32_t number_of_examples = train.number_of_images - options->number_of_validation_examples;
+    TrainingContext context = {
+        .learning_rate = options->learning_rate,
+        .number_of_epochs = options->number_of_epochs,
+        .number_of_examples = number_of_examples,
+        .schedule = options->schedule,
+        .decay_rate = options->decay_rate,
+        .decay_epochs = 1,
+        .minimum_learning_rate = options->minimum_learning_rate,
+        .warmup_examples = options->warmup_examples,
+        .schedule_every_examples = options->schedule_every_examples,
+        .validation_inputs = &train.images[(size_t)number_of_examples * train.image_size],
+        .validation_labels = &train.labels[number_of_examples],
+        .number_of_validation_examples = options->number_of_validation_examples,
+        .patience = options->patience,
+        .checkpoint_filename = options->checkpoint_filename,
+        .checkpoint_every_epochs = 1,
+        .augmentation = augmentation.images ? &augmentation : NULL,
+    };
+
+    NeuralNetwork network;
+    if (!options->checkpoint_filename || !neuralnetwork_resume(&network, &context, options->checkpoint_filename)) {
+        network = create_network(options, train.image_size, train.number_of_classes);
+    } else if (neuralnetwork_input_size(&network) != train.image_size) {
+        fprintf(stderr, "ERROR: The training images don't match the input size of the checkpoint (%d, expected %d)\n", train.image_size, neuralnetwork_input_size(&network));
+        exit(EXIT_FAILURE);
+    }
+    prepare_network(&network, options);
+
+    printf("Training %d -> %s -> %d on %d examples with %d threads...\n", train.image_size, options->topology, train.number_of_classes, number_of_examples, omp_get_max_threads());
+    uint32_t first_epoch = context.epoch;
+    double start = omp_get_wtime();
+    neuralnetwork_train(&network, train.images, train.labels, &context);
+    double seconds = omp_get_wtime() - start;
+    uint32_t epochs_run = context.epoch - first_epoch;
+    printf(
+        "Training done:\n"
+        "   %d epochs in %.2f s\n"
+        "   Throughput: %.1f examples/s\n",
+        epochs_run,
+        seconds,
+        (double)epochs_run * number_of_examples / seconds);
+
+    neuralnetwork_save(&network, &context, model_filename);
+    if (options->checkpoint_filename) {
+        remove(options->checkpoint_filename);
+    }
+    if (augmentation.images) {
+        memory_free(augmentation.images);
+    }
+    dataset_destroy(&train);
+
+    if (dataset_exists(directory, "test")) {
+        evaluate(&network, directory, options);
+    }
+    neuralnetwork_destroy(&network);
+}
+
+void command_test(const char *directory, const char *model_filename, Options *options) {
+    NeuralNetwork network;
+    TrainingContext context;
+    neuralnetwork_load(&network, &context, model_filename);
+    prepare_network(&network, options);
+
+    printf(
+        "Neural Network trained for %d epochs at learning rate %.3f on %d examples\n",
+        context.number_of_epochs,
+        context.learning_rate,
+        context.number_of_examples);
+    evaluate(&network, directory, options);
+    neuralnetwork_destroy(&network);
+}
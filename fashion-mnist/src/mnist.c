@@ -1,10 +0,0 @@
-#include "mnist.h"
-
-#include <stdint.h>
-#include <stdio.h>
-
-void prepare_input(uint8_t *raw, double *prepared, uint32_t size) {
-    for (uint32_t i = 0; i < size; i++) {
-        prepared[i] = raw[i] / 255.0;
-    }
-}
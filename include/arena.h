@@ -0,0 +1,22 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_ALIGNMENT 64
+
+// Single allocation carved into aligned slices, released at once by arena_destroy()
+typedef struct arena {
+    uint8_t *memory;
+    size_t capacity;
+    size_t size;
+} Arena;
+
+size_t arena_aligned_size(size_t size);
+
+Arena arena_create(size_t capacity);
+void *arena_allocate(Arena *arena, size_t size);
+void arena_destroy(Arena *arena);
+
+#endif  // ARENA_H
@@ -0,0 +1,23 @@
+#ifndef AUGMENTATION_H
+#define AUGMENTATION_H
+
+#include <stdint.h>
+
+#define AUGMENTATION_BATCH_SIZE 256
+
+// Random affine warp and gaussian noise of 8-bit images, reproducible from (seed, epoch, image)
+typedef struct augmentation {
+    uint8_t *images;
+    uint32_t width;
+    uint32_t height;
+    uint64_t seed;
+
+    double max_shift;     // in pixels, in each direction
+    double max_rotation;  // in degrees, in each direction
+    double max_scale;     // relative, e.g. 0.1 scales by [0.9, 1.1]
+    double noise;         // standard deviation of the noise, on the [0, 1] scale
+} Augmentation;
+
+void augmentation_apply(Augmentation *augmentation, uint32_t epoch, uint32_t first_image, uint32_t number_of_images, double *outputs);
+
+#endif  // AUGMENTATION_H
@@ -0,0 +1,28 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "neuralnetwork.h"
+
+// Writes snapshots from a background thread to '<filename>.tmp', then renames it to filename
+typedef struct checkpointer {
+    const char *filename;
+    char *temporary_filename;
+
+    pthread_t thread;
+    bool writing;
+    int status;
+
+    char *buffer;
+    size_t buffer_size;
+} Checkpointer;
+
+Checkpointer checkpointer_create(const char *filename);
+void checkpointer_snapshot(Checkpointer *checkpointer, NeuralNetwork *network, TrainingContext *context);
+int checkpointer_wait(Checkpointer *checkpointer);
+void checkpointer_destroy(Checkpointer *checkpointer);
+
+#endif  // CHECKPOINT_H
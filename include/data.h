@@ -1,12 +1,28 @@
 #ifndef DATA_H
 #define DATA_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
 uint32_t read_uint32(FILE *f);
 
+// Images are allocated with memory_allocate(), release them with memory_free()
 uint8_t *load_images(const char *filename, uint32_t image_dimension, uint32_t *num_images, uint32_t *image_size);
 uint8_t *load_labels(const char *filename, uint32_t *num_labels);
 
+void normalize_images(uint8_t *images, double *normalized, size_t size);
+
+// '<directory>/<name>-images.bin' and '<directory>/<name>-labels.bin', images normalized to [0, 1]
+typedef struct dataset {
+    uint32_t number_of_images;
+    uint32_t image_size;
+    uint32_t number_of_classes;
+    double *images;
+    uint8_t *labels;
+} Dataset;
+
+Dataset dataset_load(const char *directory, const char *name);
+void dataset_destroy(Dataset *dataset);
+
 #endif  // DATA_H
@@ -0,0 +1,34 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "neuralnetwork.h"
+
+// Number of inputs carried through the batched forward, then scored, at once
+#define EVALUATION_CHUNK_SIZE 4096
+
+// confusion_matrix[label * number_of_classes + prediction]
+typedef struct evaluation {
+    uint32_t number_of_classes;
+    uint32_t number_of_examples;
+    uint32_t top_k;
+
+    uint32_t *confusion_matrix;
+    double *precision;
+    double *recall;
+
+    double accuracy;
+    double top_k_accuracy;
+    double loss;
+
+    double seconds;
+    double examples_per_second;
+} Evaluation;
+
+Evaluation neuralnetwork_evaluate(NeuralNetwork *network, double *inputs, uint8_t *labels, uint32_t number_of_inputs, uint32_t top_k);
+void evaluation_print(Evaluation *evaluation, FILE *file);
+void evaluation_destroy(Evaluation *evaluation);
+
+#endif  // EVALUATION_H
@@ -2,13 +2,14 @@
 #define LAYER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "arena.h"
+#include "random.h"
 #include "training.h"
 
-#define RANDOM(min, max) (((max) - (min)) * (double)rand() / RAND_MAX + (min))
-
 typedef struct layerbackwardcontext {
     bool hidden_layer;
     double learning_rate;
@@ -17,8 +18,11 @@ typedef struct layerbackwardcontext {
     double *input;
     double *output;
 
+    // The output layer errors were already computed by the fused forward
+    bool errors_ready;
     double *layer_errors;
     uint32_t next_layer_output_size;
+    double *next_layer_weights;
     double *next_layer_errors;
 } LayerBackwardContext;
 
@@ -28,28 +32,61 @@ typedef enum activationfunction {
     SOFTMAX_ACTIVATION,
 } ActivationFunction;
 
+typedef enum weightinitialization {
+    UNIFORM_INITIALIZATION,
+    XAVIER_INITIALIZATION,
+    HE_INITIALIZATION,
+} WeightInitialization;
+
+// Picked by the autotuner, zero fields mean the defaults
+typedef struct layerplan {
+    int forward_threads;
+    int backward_threads;
+    uint32_t tile_block;
+} LayerPlan;
+
+#define LAYER_TILE_BLOCK 4
+
+// 16-bit weights are a read-only copy of the double weights, for inference
+typedef enum weightprecision {
+    DOUBLE_PRECISION,
+    BFLOAT16_PRECISION,
+    FLOAT16_PRECISION,
+} WeightPrecision;
+
+// weights[i * input_size + j] is the weight between input j and output i
 typedef struct layer {
     uint32_t input_size;
     double *biases;
-    double **weights;
+    double *weights;
     uint32_t output_size;
     ActivationFunction activation_function;
+    LayerPlan plan;
+    WeightPrecision precision;
+    uint16_t *compact_weights;
 } Layer;
 
 Layer layer_create(uint32_t input_size, ActivationFunction activation_function, uint32_t output_size);
-void layer_initialize(Layer *layer);
+size_t layer_memory_size(Layer *layer);
+void layer_allocate(Layer *layer, Arena *arena);
+void layer_first_touch(Layer *layer, const Layer *source);
+void layer_initialize(Layer *layer, WeightInitialization initialization, RandomStream *stream);
+void layer_compact(Layer *layer, WeightPrecision precision, uint16_t *compact_weights);
 
 void layer_forward_linear(Layer *layer, double *input, double *output);
 void layer_forward_sigmoid(Layer *layer, double *input, double *output);
 void layer_forward_softmax(Layer *layer, double *input, double *output);
+double layer_forward_softmax_cross_entropy(Layer *layer, double *input, uint32_t label, double *output, double *errors);
 void layer_forward(Layer *layer, double *input, double *output);
+void layer_forward_tile(Layer *layer, double *inputs, uint32_t tile_size, double *outputs);
+void layer_forward_tile_cross_entropy(Layer *layer, double *inputs, uint32_t tile_size, const uint8_t *labels, double *outputs, double *losses);
 
+// layer_backward() only computes the errors: compute those of all layers before any layer_update()
 void layer_backward_linear(Layer *layer, LayerBackwardContext *context);
 void layer_backward_sigmoid(Layer *layer, LayerBackwardContext *context);
 void layer_backward_softmax(Layer *layer, LayerBackwardContext *context);
 void layer_backward(Layer *layer, LayerBackwardContext *context);
-
-void layer_destroy(Layer *layer);
+void layer_update(Layer *layer, LayerBackwardContext *context);
 
 int layer_save(Layer *layer, FILE *file);
 int layer_load(Layer *layer, FILE *file);
@@ -0,0 +1,20 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+
+#define MEMORY_ALIGNMENT 64
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+// Allocations from this size are mapped directly, so their pages are only placed when first touched
+#define MEMORY_MAPPING_THRESHOLD (256UL << 10)
+
+// Aligned allocation, backed by huge pages when large, released with memory_free()
+void *memory_allocate(size_t size);
+void memory_free(void *memory);
+
+int memory_numa_nodes(void);
+int memory_current_node(void);
+void *memory_replicate_on_node(const void *source, size_t size, int node);
+
+#endif  // MEMORY_H
@@ -1,39 +1,66 @@
 #ifndef NEURAL_NETWORK_H
 #define NEURAL_NETWORK_H
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
+#include "arena.h"
 #include "layer.h"
 
+// Default number of samples carried through all the layers at once by the batched forward
+#define FORWARD_TILE_SIZE 16
+
 typedef struct backwardcontext {
     double learning_rate;
     uint32_t label;
     uint16_t number_of_layers;
     double **layers_errors;
+    // Set by neuralnetwork_forward_loss() when it already computed the output layer errors
+    bool output_errors_ready;
+    Arena arena;
 } BackwardContext;
 
+// Parameters and layers outputs share one arena, the parameters first; replicas and 16-bit weights are for inference only
 typedef struct neuralnetwork {
     uint16_t layers_capacity;
     uint16_t layers_size;
     Layer *layers;
     double **layers_outputs;
+    Arena arena;
+    size_t parameters_size;
+    uint32_t tile_size;
+    uint16_t number_of_replicas;
+    uint8_t **replicas;
+    WeightPrecision precision;
+    uint16_t *compact_weights;
 } NeuralNetwork;
 
-uint8_t max_index(double *array, uint8_t size);
+uint32_t max_index(double *array, uint32_t size);
 
 BackwardContext backwardcontext_create(NeuralNetwork *network, double learning_rate);
 void backwardcontext_destroy(BackwardContext *context);
 
 NeuralNetwork neuralnetwork_create(uint16_t number_of_layers);
 void neuralnetwork_add_layer(NeuralNetwork *network, uint32_t input_size, ActivationFunction activation_function, uint32_t output_size);
-void neuralnetwork_initialize(NeuralNetwork *network);
+void neuralnetwork_initialize(NeuralNetwork *network, WeightInitialization initialization, uint64_t seed);
+void neuralnetwork_place(NeuralNetwork *network);
+void neuralnetwork_replicate(NeuralNetwork *network);
+void neuralnetwork_set_precision(NeuralNetwork *network, WeightPrecision precision);
 
 void neuralnetwork_forward(NeuralNetwork *network, double *input);
+void neuralnetwork_forward_batch(NeuralNetwork *network, double *inputs, uint32_t number_of_inputs, double *outputs);
+// Also writes the loss of each labeled input; outputs may be NULL
+void neuralnetwork_forward_batch_loss(NeuralNetwork *network, double *inputs, uint8_t *labels, uint32_t number_of_inputs, double *outputs, double *losses);
+double neuralnetwork_forward_loss(NeuralNetwork *network, double *input, BackwardContext *backward_context);
 void neuralnetwork_backward(NeuralNetwork *network, double *input, BackwardContext *backward_context);
 void neuralnetwork_train(NeuralNetwork *network, double *inputs, uint8_t *labels, TrainingContext *context);
 
-uint8_t neuralnetwork_ask(NeuralNetwork *network, double *input);
+uint32_t neuralnetwork_ask(NeuralNetwork *network, double *input);
+void neuralnetwork_ask_batch(NeuralNetwork *network, double *inputs, uint32_t number_of_inputs, uint32_t *answers);
 double neuralnetwork_benchmark(NeuralNetwork *network, double *inputs, uint8_t *labels, uint32_t number_of_inputs);
+double neuralnetwork_output_loss(NeuralNetwork *network, double *output, uint32_t label);
+double neuralnetwork_loss(NeuralNetwork *network, double *inputs, uint8_t *labels, uint32_t number_of_inputs);
 
 uint32_t neuralnetwork_input_size(NeuralNetwork *network);
 uint32_t neuralnetwok_output_size(NeuralNetwork *network);
@@ -41,7 +68,9 @@ double *neuralnetwork_output(NeuralNetwork *network);
 
 void neuralnetwork_destroy(NeuralNetwork *network);
 
+int neuralnetwork_write(NeuralNetwork *network, TrainingContext *context, FILE *file);
 void neuralnetwork_save(NeuralNetwork *network, TrainingContext *context, const char *filename);
 void neuralnetwork_load(NeuralNetwork *network, TrainingContext *context, const char *filename);
+bool neuralnetwork_resume(NeuralNetwork *network, TrainingContext *context, const char *filename);
 
 #endif  // NEURAL_NETWORK_H
@@ -0,0 +1,17 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+// Counter-based: a draw only depends on (seed, stream, counter), whatever the thread
+typedef struct randomstream {
+    uint64_t key;
+} RandomStream;
+
+RandomStream random_stream(uint64_t seed, uint64_t stream_id);
+
+uint64_t random_uint64(RandomStream *stream, uint64_t counter);
+double random_uniform(RandomStream *stream, uint64_t counter, double min, double max);
+double random_normal(RandomStream *stream, uint64_t counter, double mean, double standard_deviation);
+
+#endif  // RANDOM_H
@@ -2,15 +2,68 @@
 #define TRAINING_CONTEXT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include "augmentation.h"
+
+typedef enum learningrateschedule {
+    CONSTANT_SCHEDULE,
+    STEP_SCHEDULE,         // multiplied by decay_rate every decay_epochs epochs
+    EXPONENTIAL_SCHEDULE,  // multiplied by decay_rate every epoch
+    COSINE_SCHEDULE,       // cosine annealing down to minimum_learning_rate at the last epoch
+    PLATEAU_SCHEDULE,      // multiplied by decay_rate after decay_epochs epochs without improvement
+} LearningRateSchedule;
+
 typedef struct trainingcontext {
     double learning_rate;
     uint32_t number_of_epochs;
     uint32_t number_of_examples;
+
+    // Learning rate schedule (saved), after a linear warmup
+    LearningRateSchedule schedule;
+    double decay_rate;
+    uint32_t decay_epochs;
+    double minimum_learning_rate;
+    uint32_t warmup_examples;
+    uint32_t schedule_every_examples;
+    // Plateau schedule state (saved): best epoch score, and epochs since it
+    double plateau_best_score;
+    uint32_t plateau_epochs;
+
+    // Optional held-out validation set, evaluated at the end of each epoch (not saved)
+    double *validation_inputs;
+    uint8_t *validation_labels;
+    uint32_t number_of_validation_examples;
+    // Stop after this many epochs without validation improvement, 0 to disable
+    uint32_t patience;
+
+    // Early stopping state (saved), filled in by the training when a validation set is given
+    double best_validation_accuracy;
+    uint32_t best_epoch;
+    uint32_t epochs_without_improvement;
+    uint8_t *best_parameters;
+    size_t best_parameters_size;
+
+    // Training progress (saved): completed epochs, and examples done in the current epoch
+    uint32_t epoch;
+    uint32_t example;
+
+    // Optional periodic checkpointing, every given number of epochs and/or examples (not saved)
+    const char *checkpoint_filename;
+    uint32_t checkpoint_every_epochs;
+    uint32_t checkpoint_every_examples;
+
+    // Optional on-the-fly augmentation, which replaces the inputs (not saved)
+    Augmentation *augmentation;
+
+    // Do not print the progress of the training (not saved)
+    bool quiet;
 } TrainingContext;
 
+double trainingcontext_learning_rate(TrainingContext *context);
+
 int trainingcontext_save(TrainingContext *context, FILE *file);
 int trainingcontext_load(TrainingContext *context, FILE *file);
 
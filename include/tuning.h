@@ -0,0 +1,9 @@
+#ifndef TUNING_H
+#define TUNING_H
+
+#include "neuralnetwork.h"
+
+// Benchmarks the kernel threads and tile sizes on this machine, caching the winning plans in cache_filename
+void neuralnetwork_autotune(NeuralNetwork *network, const char *cache_filename);
+
+#endif  // TUNING_H
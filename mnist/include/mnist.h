@@ -1,20 +1,21 @@
 #ifndef MNIST_H
 #define MNIST_H
 
-#include <stdint.h>
+#define DATA_DIRECTORY "data"
+#define MODEL_FILENAME "model/nn_mnist.bin"
+#define CHECKPOINT_FILENAME "model/checkpoint.bin"
+#define AUTOTUNE_CACHE "model/autotune.cache"
 
-#define NUMBER_OF_IMAGES_TRAIN 60000
-#define NUMBER_OF_IMAGES_TEST 10000
+#define HIDDEN_SIZE "89"
+#define LEARNING_RATE 0.10
+#define NUMBER_OF_EPOCHS 5
+#define NUMBER_OF_IMAGES_VALIDATION 5000
+#define RANDOM_SEED 42
 
-#define IMAGE_WIDTH 28
-#define IMAGE_HEIGHT 28
-#define IMAGE_SIZE (IMAGE_HEIGHT * IMAGE_WIDTH)
-#define IMAGE_DIMENSION 1
-
-#define INPUT_SIZE (IMAGE_SIZE * IMAGE_DIMENSION)
-#define HIDDEN_SIZE 89
-#define OUTPUT_SIZE 10
-
-void prepare_input(uint8_t *raw, double *prepared, uint32_t size);
+// No augmentation of the training images
+#define MAX_SHIFT 0.0
+#define MAX_ROTATION 0.0
+#define MAX_SCALE 0.0
+#define NOISE 0.0
 
 #endif  // MNIST_H
@@ -0,0 +1,20 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Unix domain stream socket, host byte order: the server sends input_size and output_size (uint32_t),
+// then answers each request of input_size doubles with the predicted class (uint32_t)
+#define DEFAULT_SOCKET_PATH "/tmp/ann-c.sock"
+
+typedef struct handshake {
+    uint32_t input_size;
+    uint32_t output_size;
+} Handshake;
+
+bool read_fully(int fd, void *buffer, size_t size);
+bool write_fully(int fd, const void *buffer, size_t size);
+
+#endif  // PROTOCOL_H
@@ -0,0 +1,164 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "protocol.h"
+#include "random.h"
+
+#define DEFAULT_NUMBER_OF_CONNECTIONS 8
+#define DEFAULT_REQUESTS_PER_CONNECTION 1000
+#define RANDOM_SEED 42
+
+typedef struct loadgenerator {
+    const char *socket_path;
+    uint32_t connection_id;
+    uint32_t number_of_requests;
+    double *latencies_us;
+    uint32_t number_of_answers;
+} LoadGenerator;
+
+static double elapsed_us(struct timespec start, struct timespec end) {
+    return (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+}
+
+static int client_connect(const char *socket_path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "ERROR: Socket path too long: '%s'\n", socket_path);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        perror("connect() failed at client_connect()");
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+static void *loadgenerator_run(void *argument) {
+    LoadGenerator *generator = (LoadGenerator *)argument;
+    int fd = client_connect(generator->socket_path);
+
+    Handshake handshake;
+    if (!read_fully(fd, &handshake, sizeof(Handshake))) {
+        fprintf(stderr, "ERROR: Failed to read the handshake\n");
+        exit(EXIT_FAILURE);
+    }
+
+    double *input = (double *)malloc(sizeof(double) * handshake.input_size);
+    if (!input) {
+        fprintf(stderr, "ERROR: malloc() failed at loadgenerator_run()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    RandomStream stream = random_stream(RANDOM_SEED, generator->connection_id);
+    for (uint32_t i = 0; i < generator->number_of_requests; i++) {
+        for (uint32_t j = 0; j < handshake.input_size; j++) {
+            input[j] = random_uniform(&stream, (uint64_t)i * handshake.input_size + j, 0.0, 1.0);
+        }
+
+        struct timespec start, end;
+        uint32_t answer;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (!write_fully(fd, input, sizeof(double) * handshake.input_size) || !read_fully(fd, &answer, sizeof(uint32_t))) {
+            fprintf(stderr, "ERROR: Connection %d closed by the server\n", generator->connection_id);
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        generator->latencies_us[generator->number_of_answers++] = elapsed_us(start, end);
+    }
+
+    free(input);
+    close(fd);
+    return NULL;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double *sorted, uint32_t size, double p) {
+    uint32_t index = (uint32_t)(p * (size - 1) + 0.5);
+    return sorted[index];
+}
+
+int main(int argc, char **argv) {
+    const char *socket_path = (argc > 1) ? argv[1] : DEFAULT_SOCKET_PATH;
+    uint32_t number_of_connections = (argc > 2) ? (uint32_t)atoi(argv[2]) : DEFAULT_NUMBER_OF_CONNECTIONS;
+    uint32_t requests_per_connection = (argc > 3) ? (uint32_t)atoi(argv[3]) : DEFAULT_REQUESTS_PER_CONNECTION;
+    if (number_of_connections == 0 || requests_per_connection == 0) {
+        fprintf(stderr, "Usage: %s [SOCKET_PATH] [CONNECTIONS] [REQUESTS_PER_CONNECTION]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    LoadGenerator *generators = (LoadGenerator *)malloc(sizeof(LoadGenerator) * number_of_connections);
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * number_of_connections);
+    double *latencies_us = (double *)malloc(sizeof(double) * number_of_connections * requests_per_connection);
+    if (!generators || !threads || !latencies_us) {
+        fprintf(stderr, "ERROR: malloc() failed at main()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < number_of_connections; i++) {
+        generators[i] = (LoadGenerator){
+            .socket_path = socket_path,
+            .connection_id = i,
+            .number_of_requests = requests_per_connection,
+            .latencies_us = &latencies_us[(size_t)i * requests_per_connection],
+            .number_of_answers = 0,
+        };
+        if (pthread_create(&threads[i], NULL, loadgenerator_run, &generators[i]) != 0) {
+            fprintf(stderr, "ERROR: pthread_create() failed at main()\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (uint32_t i = 0; i < number_of_connections; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // Gather the answered requests' latencies at the front of the array
+    uint32_t number_of_answers = 0;
+    for (uint32_t i = 0; i < number_of_connections; i++) {
+        memmove(&latencies_us[number_of_answers], generators[i].latencies_us, sizeof(double) * generators[i].number_of_answers);
+        number_of_answers += generators[i].number_of_answers;
+    }
+    if (number_of_answers == 0) {
+        fprintf(stderr, "ERROR: No request was answered\n");
+        exit(EXIT_FAILURE);
+    }
+    qsort(latencies_us, number_of_answers, sizeof(double), compare_doubles);
+
+    double seconds = elapsed_us(start, end) / 1e6;
+    printf(
+        "Load generator results:\n"
+        "   %d connections, %d requests answered in %.3f s\n"
+        "   Throughput: %.1f requests/s\n"
+        "   Latency p50: %.1f us\n"
+        "   Latency p99: %.1f us\n",
+        number_of_connections,
+        number_of_answers,
+        seconds,
+        number_of_answers / seconds,
+        percentile(latencies_us, number_of_answers, 0.50),
+        percentile(latencies_us, number_of_answers, 0.99));
+
+    free(latencies_us);
+    free(threads);
+    free(generators);
+    return EXIT_SUCCESS;
+}
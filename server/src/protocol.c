@@ -0,0 +1,39 @@
+#include "protocol.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+bool read_fully(int fd, void *buffer, size_t size) {
+    uint8_t *bytes = (uint8_t *)buffer;
+    while (size > 0) {
+        ssize_t res = read(fd, bytes, size);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return false;
+        }
+        bytes += res;
+        size -= res;
+    }
+    return true;
+}
+
+bool write_fully(int fd, const void *buffer, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)buffer;
+    while (size > 0) {
+        ssize_t res = write(fd, bytes, size);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return false;
+        }
+        bytes += res;
+        size -= res;
+    }
+    return true;
+}
@@ -0,0 +1,270 @@
+#include <omp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "neuralnetwork.h"
+#include "protocol.h"
+
+#define DEFAULT_MAX_BATCH_SIZE 64
+#define DEFAULT_MAX_DELAY_US 2000
+#define DEFAULT_NUMBER_OF_WORKERS 2
+
+#define QUEUE_CAPACITY 4096
+
+typedef struct request {
+    double *input;
+    uint32_t answer;
+    bool done;
+    struct timespec arrival;
+    pthread_cond_t done_condition;
+} Request;
+
+// A batch is taken when max_batch_size requests are pending, or the oldest waited max_delay_us
+typedef struct server {
+    NeuralNetwork network;
+    uint32_t input_size;
+    uint32_t output_size;
+
+    uint32_t max_batch_size;
+    long max_delay_us;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t pending_condition;
+    pthread_cond_t space_condition;
+    Request *queue[QUEUE_CAPACITY];
+    uint32_t queue_head;
+    uint32_t queue_size;
+} Server;
+
+typedef struct connection {
+    Server *server;
+    int fd;
+} Connection;
+
+static struct timespec deadline_after(struct timespec start, long delay_us) {
+    struct timespec deadline = start;
+    deadline.tv_nsec += delay_us * 1000;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    return deadline;
+}
+
+static bool deadline_passed(struct timespec deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec);
+}
+
+static void server_submit(Server *server, Request *request) {
+    pthread_mutex_lock(&server->mutex);
+    while (server->queue_size == QUEUE_CAPACITY) {
+        pthread_cond_wait(&server->space_condition, &server->mutex);
+    }
+
+    clock_gettime(CLOCK_REALTIME, &request->arrival);
+    server->queue[(server->queue_head + server->queue_size) % QUEUE_CAPACITY] = request;
+    server->queue_size += 1;
+    pthread_cond_signal(&server->pending_condition);
+
+    while (!request->done) {
+        pthread_cond_wait(&request->done_condition, &server->mutex);
+    }
+    pthread_mutex_unlock(&server->mutex);
+}
+
+static void *connection_handle(void *argument) {
+    Connection *connection = (Connection *)argument;
+    Server *server = connection->server;
+
+    Handshake handshake = {
+        .input_size = server->input_size,
+        .output_size = server->output_size,
+    };
+    double *input = (double *)malloc(sizeof(double) * server->input_size);
+    if (!input) {
+        fprintf(stderr, "ERROR: malloc() failed at connection_handle()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    Request request = {.input = input};
+    pthread_cond_init(&request.done_condition, NULL);
+
+    bool open = write_fully(connection->fd, &handshake, sizeof(Handshake));
+    while (open && read_fully(connection->fd, input, sizeof(double) * server->input_size)) {
+        request.done = false;
+        server_submit(server, &request);
+
+        open = write_fully(connection->fd, &request.answer, sizeof(uint32_t));
+    }
+
+    pthread_cond_destroy(&request.done_condition);
+    close(connection->fd);
+    free(input);
+    free(connection);
+    return NULL;
+}
+
+static void *worker_run(void *argument) {
+    Server *server = (Server *)argument;
+
+    // The workers are the parallelism: each one runs its batches on a single thread
+    omp_set_num_threads(1);
+
+    Request **batch = (Request **)malloc(sizeof(Request *) * server->max_batch_size);
+    double *inputs = (double *)malloc(sizeof(double) * server->max_batch_size * server->input_size);
+    uint32_t *answers = (uint32_t *)malloc(server->max_batch_size * sizeof(uint32_t));
+    if (!batch || !inputs || !answers) {
+        fprintf(stderr, "ERROR: malloc() failed at worker_run()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&server->mutex);
+        while (server->queue_size == 0) {
+            pthread_cond_wait(&server->pending_condition, &server->mutex);
+        }
+        struct timespec deadline = deadline_after(server->queue[server->queue_head]->arrival, server->max_delay_us);
+        while (server->queue_size > 0 && server->queue_size < server->max_batch_size && !deadline_passed(deadline)) {
+            pthread_cond_timedwait(&server->pending_condition, &server->mutex, &deadline);
+        }
+
+        uint32_t batch_size = (server->queue_size < server->max_batch_size) ? server->queue_size : server->max_batch_size;
+        for (uint32_t i = 0; i < batch_size; i++) {
+            batch[i] = server->queue[server->queue_head];
+            server->queue_head = (server->queue_head + 1) % QUEUE_CAPACITY;
+        }
+        server->queue_size -= batch_size;
+        pthread_cond_broadcast(&server->space_condition);
+        if (server->queue_size > 0) {
+            pthread_cond_signal(&server->pending_condition);
+        }
+        pthread_mutex_unlock(&server->mutex);
+
+        if (batch_size == 0) {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < batch_size; i++) {
+            memcpy(&inputs[(size_t)i * server->input_size], batch[i]->input, sizeof(double) * server->input_size);
+        }
+        neuralnetwork_ask_batch(&server->network, inputs, batch_size, answers);
+
+        pthread_mutex_lock(&server->mutex);
+        for (uint32_t i = 0; i < batch_size; i++) {
+            batch[i]->answer = answers[i];
+            batch[i]->done = true;
+            pthread_cond_signal(&batch[i]->done_condition);
+        }
+        pthread_mutex_unlock(&server->mutex);
+    }
+
+    return NULL;
+}
+
+static int server_listen(const char *socket_path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "ERROR: Socket path too long: '%s'\n", socket_path);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket() failed at server_listen()");
+        exit(EXIT_FAILURE);
+    }
+
+    unlink(socket_path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror("bind() failed at server_listen()");
+        exit(EXIT_FAILURE);
+    }
+
+    return fd;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s MODEL [SOCKET_PATH] [MAX_BATCH_SIZE] [MAX_DELAY_US] [WORKERS]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char *socket_path = (argc > 2) ? argv[2] : DEFAULT_SOCKET_PATH;
+    uint32_t number_of_workers = (argc > 5) ? (uint32_t)atoi(argv[5]) : DEFAULT_NUMBER_OF_WORKERS;
+
+    Server *server = (Server *)calloc(1, sizeof(Server));
+    if (!server) {
+        fprintf(stderr, "ERROR: calloc() failed at main()\n");
+        exit(EXIT_FAILURE);
+    }
+    server->max_batch_size = (argc > 3) ? (uint32_t)atoi(argv[3]) : DEFAULT_MAX_BATCH_SIZE;
+    server->max_delay_us = (argc > 4) ? atol(argv[4]) : DEFAULT_MAX_DELAY_US;
+    if (server->max_batch_size == 0 || number_of_workers == 0) {
+        fprintf(stderr, "ERROR: The batch size and the number of workers must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    TrainingContext context;
+    neuralnetwork_load(&server->network, &context, argv[1]);
+    neuralnetwork_replicate(&server->network);
+    server->input_size = neuralnetwork_input_size(&server->network);
+    server->output_size = neuralnetwok_output_size(&server->network);
+    pthread_mutex_init(&server->mutex, NULL);
+    pthread_cond_init(&server->pending_condition, NULL);
+    pthread_cond_init(&server->space_condition, NULL);
+
+    signal(SIGPIPE, SIG_IGN);
+    int listen_fd = server_listen(socket_path);
+
+    for (uint32_t i = 0; i < number_of_workers; i++) {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, worker_run, server) != 0) {
+            fprintf(stderr, "ERROR: pthread_create() failed at main()\n");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(worker);
+    }
+
+    printf(
+        "Serving '%s' on '%s' (%d -> %d)\n"
+        "   max batch size: %d\n"
+        "   max delay: %ld us\n"
+        "   workers: %d\n",
+        argv[1], socket_path, server->input_size, server->output_size, server->max_batch_size, server->max_delay_us, number_of_workers);
+
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            perror("accept() failed at main()");
+            continue;
+        }
+
+        Connection *connection = (Connection *)malloc(sizeof(Connection));
+        if (!connection) {
+            fprintf(stderr, "ERROR: malloc() failed at main()\n");
+            exit(EXIT_FAILURE);
+        }
+        connection->server = server;
+        connection->fd = fd;
+
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, connection_handle, connection) != 0) {
+            fprintf(stderr, "ERROR: pthread_create() failed at main()\n");
+            close(fd);
+            free(connection);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,42 @@
+#include "arena.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "memory.h"
+
+size_t arena_aligned_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+}
+
+Arena arena_create(size_t capacity) {
+    Arena arena = {
+        .capacity = arena_aligned_size(capacity),
+        .size = 0,
+    };
+
+    arena.memory = (uint8_t *)memory_allocate(arena.capacity);
+
+    return arena;
+}
+
+void *arena_allocate(Arena *arena, size_t size) {
+    size_t aligned_size = arena_aligned_size(size);
+    if (arena->size + aligned_size > arena->capacity) {
+        fprintf(stderr, "ERROR: Out of memory at arena_allocate() (capacity %zu, requested %zu)\n", arena->capacity, arena->size + aligned_size);
+        exit(EXIT_FAILURE);
+    }
+
+    void *slice = arena->memory + arena->size;
+    arena->size += aligned_size;
+    return slice;
+}
+
+void arena_destroy(Arena *arena) {
+    memory_free(arena->memory);
+    arena->memory = NULL;
+    arena->capacity = 0;
+    arena->size = 0;
+}
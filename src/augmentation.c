@@ -0,0 +1,81 @@
+#include "augmentation.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "random.h"
+
+// Random draws per image from the warp stream: shift x, shift y, rotation, scale
+#define WARP_DRAWS 4
+
+static inline double pixel(const uint8_t *image, int32_t width, int32_t height, int32_t x, int32_t y) {
+    return (x >= 0 && x < width && y >= 0 && y < height) ? image[y * width + x] : 0.0;
+}
+
+// Inverse mapping: each output pixel samples the source image where the warp sends it back
+static void augmentation_warp(const uint8_t *image, int32_t width, int32_t height, const double inverse[4], double shift_x, double shift_y, double *output) {
+    double center_x = (width - 1) / 2.0;
+    double center_y = (height - 1) / 2.0;
+
+    for (int32_t y = 0; y < height; y++) {
+        double dy = y - center_y - shift_y;
+#pragma omp simd
+        for (int32_t x = 0; x < width; x++) {
+            double dx = x - center_x - shift_x;
+            double u = inverse[0] * dx + inverse[1] * dy + center_x;
+            double v = inverse[2] * dx + inverse[3] * dy + center_y;
+
+            double u0 = floor(u);
+            double v0 = floor(v);
+            double fu = u - u0;
+            double fv = v - v0;
+            int32_t x0 = (int32_t)u0;
+            int32_t y0 = (int32_t)v0;
+
+            double top = (1.0 - fu) * pixel(image, width, height, x0, y0) + fu * pixel(image, width, height, x0 + 1, y0);
+            double bottom = (1.0 - fu) * pixel(image, width, height, x0, y0 + 1) + fu * pixel(image, width, height, x0 + 1, y0 + 1);
+            output[y * width + x] = ((1.0 - fv) * top + fv * bottom) / 255.0;
+        }
+    }
+}
+
+static void augmentation_noise(RandomStream *stream, uint64_t image, size_t image_size, double noise, double *output) {
+    for (size_t i = 0; i < image_size; i++) {
+        double value = output[i] + random_normal(stream, image * image_size + i, 0.0, noise);
+        output[i] = fmin(fmax(value, 0.0), 1.0);
+    }
+}
+
+void augmentation_apply(Augmentation *augmentation, uint32_t epoch, uint32_t first_image, uint32_t number_of_images, double *outputs) {
+    size_t image_size = (size_t)augmentation->width * augmentation->height;
+
+    // Separate streams, as the normal draws of the noise consume two counters each
+    RandomStream warp_stream = random_stream(augmentation->seed, 2 * (uint64_t)epoch);
+    RandomStream noise_stream = random_stream(augmentation->seed, 2 * (uint64_t)epoch + 1);
+
+#pragma omp parallel for schedule(static)
+    for (uint32_t i = 0; i < number_of_images; i++) {
+        uint64_t image = (uint64_t)first_image + i;
+        uint64_t counter = image * WARP_DRAWS;
+
+        double shift_x = random_uniform(&warp_stream, counter, -augmentation->max_shift, augmentation->max_shift);
+        double shift_y = random_uniform(&warp_stream, counter + 1, -augmentation->max_shift, augmentation->max_shift);
+        double angle = random_uniform(&warp_stream, counter + 2, -augmentation->max_rotation, augmentation->max_rotation) * M_PI / 180.0;
+        double scale = random_uniform(&warp_stream, counter + 3, 1.0 - augmentation->max_scale, 1.0 + augmentation->max_scale);
+
+        // Inverse of the rotation by angle composed with the scaling
+        double inverse[4] = {
+            cos(angle) / scale,
+            sin(angle) / scale,
+            -sin(angle) / scale,
+            cos(angle) / scale,
+        };
+
+        double *output = &outputs[(size_t)i * image_size];
+        augmentation_warp(&augmentation->images[image * image_size], augmentation->width, augmentation->height, inverse, shift_x, shift_y, output);
+        if (augmentation->noise > 0.0) {
+            augmentation_noise(&noise_stream, image, image_size, augmentation->noise, output);
+        }
+    }
+}
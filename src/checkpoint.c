@@ -0,0 +1,99 @@
+#include "checkpoint.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+Checkpointer checkpointer_create(const char *filename) {
+    Checkpointer checkpointer = {
+        .filename = filename,
+        .writing = false,
+        .status = EXIT_SUCCESS,
+        .buffer = NULL,
+        .buffer_size = 0,
+    };
+
+    checkpointer.temporary_filename = (char *)malloc(strlen(filename) + sizeof(".tmp"));
+    if (!checkpointer.temporary_filename) {
+        fprintf(stderr, "ERROR: malloc() failed at checkpointer_create()\n");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(checkpointer.temporary_filename, "%s.tmp", filename);
+
+    return checkpointer;
+}
+
+static void *checkpointer_write(void *argument) {
+    Checkpointer *checkpointer = (Checkpointer *)argument;
+    checkpointer->status = EXIT_FAILURE;
+
+    FILE *file = fopen(checkpointer->temporary_filename, "wb");
+    if (!file) {
+        perror("fopen() failed at checkpointer_write()");
+        return NULL;
+    }
+
+    bool written = fwrite(checkpointer->buffer, 1, checkpointer->buffer_size, file) == checkpointer->buffer_size;
+    written = written && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0 || !written) {
+        perror("fwrite() failed at checkpointer_write()");
+        return NULL;
+    }
+
+    if (rename(checkpointer->temporary_filename, checkpointer->filename) != 0) {
+        perror("rename() failed at checkpointer_write()");
+        return NULL;
+    }
+
+    checkpointer->status = EXIT_SUCCESS;
+    return NULL;
+}
+
+void checkpointer_snapshot(Checkpointer *checkpointer, NeuralNetwork *network, TrainingContext *context) {
+    checkpointer_wait(checkpointer);
+
+    free(checkpointer->buffer);
+    checkpointer->buffer = NULL;
+    checkpointer->buffer_size = 0;
+
+    FILE *stream = open_memstream(&checkpointer->buffer, &checkpointer->buffer_size);
+    if (!stream) {
+        perror("open_memstream() failed at checkpointer_snapshot()");
+        exit(EXIT_FAILURE);
+    }
+    if (neuralnetwork_write(network, context, stream)) {
+        fclose(stream);
+        exit(EXIT_FAILURE);
+    }
+    fclose(stream);
+
+    if (pthread_create(&checkpointer->thread, NULL, checkpointer_write, checkpointer) != 0) {
+        fprintf(stderr, "ERROR: pthread_create() failed at checkpointer_snapshot()\n");
+        exit(EXIT_FAILURE);
+    }
+    checkpointer->writing = true;
+}
+
+int checkpointer_wait(Checkpointer *checkpointer) {
+    if (!checkpointer->writing) {
+        return checkpointer->status;
+    }
+
+    pthread_join(checkpointer->thread, NULL);
+    checkpointer->writing = false;
+    if (checkpointer->status != EXIT_SUCCESS) {
+        fprintf(stderr, "WARNING: Failed to write checkpoint '%s'\n", checkpointer->filename);
+    }
+    return checkpointer->status;
+}
+
+void checkpointer_destroy(Checkpointer *checkpointer) {
+    checkpointer_wait(checkpointer);
+    free(checkpointer->buffer);
+    free(checkpointer->temporary_filename);
+    checkpointer->buffer = NULL;
+    checkpointer->temporary_filename = NULL;
+}
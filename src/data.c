@@ -1,9 +1,14 @@
 #include "data.h"
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "memory.h"
+
+#define MAX_PATH_LENGTH 1024
+
 uint32_t read_uint32(FILE *file) {
     uint32_t integer;
     if (fread(&integer, sizeof(uint32_t), 1, file) != 1) {
@@ -25,15 +30,11 @@ uint8_t *load_images(const char *filename, uint32_t image_dimension, uint32_t *n
     uint32_t cols = read_uint32(f);
     *image_size = rows * cols;
 
-    uint8_t *images = (uint8_t *)malloc((*num_images) * (*image_size) * image_dimension);
-    if (!images) {
-        perror("Failed to allocate memory for images at load_images()");
-        exit(EXIT_FAILURE);
-    }
+    uint8_t *images = (uint8_t *)memory_allocate((size_t)(*num_images) * (*image_size) * image_dimension);
 
     if (fread(images, *image_size, *num_images, f) != (size_t)(*num_images)) {
         perror("Failed to read images at load_images()");
-        free(images);
+        memory_free(images);
         exit(EXIT_FAILURE);
     }
 
@@ -67,3 +68,43 @@ uint8_t *load_labels(const char *filename, uint32_t *num_labels) {
     fclose(f);
     return labels;
 }
+
+void normalize_images(uint8_t *images, double *normalized, size_t size) {
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < size; i++) {
+        normalized[i] = images[i] / 255.0;
+    }
+}
+
+Dataset dataset_load(const char *directory, const char *name) {
+    char images_filename[MAX_PATH_LENGTH], labels_filename[MAX_PATH_LENGTH];
+    snprintf(images_filename, MAX_PATH_LENGTH, "%s/%s-images.bin", directory, name);
+    snprintf(labels_filename, MAX_PATH_LENGTH, "%s/%s-labels.bin", directory, name);
+
+    Dataset dataset;
+    uint32_t number_of_labels;
+    uint8_t *images = load_images(images_filename, 1, &dataset.number_of_images, &dataset.image_size);
+    dataset.labels = load_labels(labels_filename, &number_of_labels);
+    if (dataset.number_of_images != number_of_labels) {
+        fprintf(stderr, "ERROR: The number of images and labels don't match in '%s'\n", directory);
+        exit(EXIT_FAILURE);
+    }
+
+    dataset.number_of_classes = 0;
+    for (uint32_t i = 0; i < number_of_labels; i++) {
+        dataset.number_of_classes = (dataset.labels[i] >= dataset.number_of_classes) ? dataset.labels[i] + 1u : dataset.number_of_classes;
+    }
+
+    dataset.images = (double *)memory_allocate(sizeof(double) * dataset.number_of_images * dataset.image_size);
+    normalize_images(images, dataset.images, (size_t)dataset.number_of_images * dataset.image_size);
+    memory_free(images);
+
+    return dataset;
+}
+
+void dataset_destroy(Dataset *dataset) {
+    memory_free(dataset->images);
+    free(dataset->labels);
+    dataset->images = NULL;
+    dataset->labels = NULL;
+}
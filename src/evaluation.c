@@ -0,0 +1,126 @@
+#include "evaluation.h"
+
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "memory.h"
+
+// Larger confusion matrices are not printed by evaluation_print()
+#define EVALUATION_PRINT_CLASSES 32
+
+Evaluation neuralnetwork_evaluate(NeuralNetwork *network, double *inputs, uint8_t *labels, uint32_t number_of_inputs, uint32_t top_k) {
+    uint32_t input_size = neuralnetwork_input_size(network);
+    uint32_t number_of_classes = neuralnetwok_output_size(network);
+    size_t confusion_size = (size_t)number_of_classes * number_of_classes;
+
+    Evaluation evaluation = {
+        .number_of_classes = number_of_classes,
+        .number_of_examples = number_of_inputs,
+        .top_k = (top_k > 0) ? top_k : 1,
+    };
+    evaluation.confusion_matrix = (uint32_t *)calloc(confusion_size, sizeof(uint32_t));
+    evaluation.precision = (double *)malloc(sizeof(double) * number_of_classes);
+    evaluation.recall = (double *)malloc(sizeof(double) * number_of_classes);
+    if (!evaluation.confusion_matrix || !evaluation.precision || !evaluation.recall) {
+        fprintf(stderr, "ERROR: malloc() failed at neuralnetwork_evaluate()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t chunk_capacity = (number_of_inputs < EVALUATION_CHUNK_SIZE) ? number_of_inputs : EVALUATION_CHUNK_SIZE;
+    double *outputs = (double *)memory_allocate(sizeof(double) * ((chunk_capacity > 0) ? chunk_capacity : 1) * number_of_classes);
+    double *losses = (double *)memory_allocate(sizeof(double) * ((chunk_capacity > 0) ? chunk_capacity : 1));
+    uint32_t *confusion_matrix = evaluation.confusion_matrix;
+    uint32_t correct = 0;
+    uint32_t top_k_correct = 0;
+    double loss = 0.0;
+
+    double start = omp_get_wtime();
+    for (uint32_t first = 0; first < number_of_inputs; first += chunk_capacity) {
+        uint32_t chunk_size = (number_of_inputs - first < chunk_capacity) ? number_of_inputs - first : chunk_capacity;
+        neuralnetwork_forward_batch_loss(network, &inputs[(size_t)first * input_size], &labels[first], chunk_size, outputs, losses);
+
+#pragma omp parallel for schedule(static) reduction(+ : correct, top_k_correct, loss, confusion_matrix[:confusion_size])
+        for (uint32_t s = 0; s < chunk_size; s++) {
+            double *output = &outputs[(size_t)s * number_of_classes];
+            uint32_t label = labels[first + s];
+
+            uint32_t prediction = max_index(output, number_of_classes);
+            uint32_t rank = 0;
+            for (uint32_t c = 0; c < number_of_classes; c++) {
+                rank += (output[c] > output[label]) ? 1 : 0;
+            }
+
+            confusion_matrix[(size_t)label * number_of_classes + prediction] += 1;
+            correct += (prediction == label) ? 1 : 0;
+            top_k_correct += (rank < evaluation.top_k) ? 1 : 0;
+            loss += losses[s];
+        }
+    }
+    evaluation.seconds = omp_get_wtime() - start;
+    memory_free(outputs);
+    memory_free(losses);
+
+    for (uint32_t c = 0; c < number_of_classes; c++) {
+        uint32_t predicted = 0;
+        uint32_t labeled = 0;
+        for (uint32_t k = 0; k < number_of_classes; k++) {
+            predicted += confusion_matrix[(size_t)k * number_of_classes + c];
+            labeled += confusion_matrix[(size_t)c * number_of_classes + k];
+        }
+        uint32_t true_positives = confusion_matrix[(size_t)c * number_of_classes + c];
+        evaluation.precision[c] = (predicted > 0) ? (double)true_positives / predicted : 0.0;
+        evaluation.recall[c] = (labeled > 0) ? (double)true_positives / labeled : 0.0;
+    }
+
+    if (number_of_inputs > 0) {
+        evaluation.accuracy = (double)correct / number_of_inputs;
+        evaluation.top_k_accuracy = (double)top_k_correct / number_of_inputs;
+        evaluation.loss = loss / number_of_inputs;
+    }
+    evaluation.examples_per_second = (evaluation.seconds > 0.0) ? number_of_inputs / evaluation.seconds : 0.0;
+
+    return evaluation;
+}
+
+void evaluation_print(Evaluation *evaluation, FILE *file) {
+    fprintf(
+        file,
+        "Evaluation on %d examples (%.3f s, %.1f examples/s):\n"
+        "   Accuracy: %.3f%%\n"
+        "   Top-%d accuracy: %.3f%%\n"
+        "   Average loss: %.4f\n"
+        "   Precision / recall per class:\n",
+        evaluation->number_of_examples,
+        evaluation->seconds,
+        evaluation->examples_per_second,
+        evaluation->accuracy * 100,
+        evaluation->top_k,
+        evaluation->top_k_accuracy * 100,
+        evaluation->loss);
+    for (uint32_t c = 0; c < evaluation->number_of_classes; c++) {
+        fprintf(file, "      %4d: %.3f / %.3f\n", c, evaluation->precision[c], evaluation->recall[c]);
+    }
+
+    if (evaluation->number_of_classes > EVALUATION_PRINT_CLASSES) {
+        return;
+    }
+    fprintf(file, "   Confusion matrix (rows: labels, columns: predictions):\n");
+    for (uint32_t label = 0; label < evaluation->number_of_classes; label++) {
+        fprintf(file, "     ");
+        for (uint32_t prediction = 0; prediction < evaluation->number_of_classes; prediction++) {
+            fprintf(file, " %6d", evaluation->confusion_matrix[(size_t)label * evaluation->number_of_classes + prediction]);
+        }
+        fprintf(file, "\n");
+    }
+}
+
+void evaluation_destroy(Evaluation *evaluation) {
+    free(evaluation->confusion_matrix);
+    free(evaluation->precision);
+    free(evaluation->recall);
+    evaluation->confusion_matrix = NULL;
+    evaluation->precision = NULL;
+    evaluation->recall = NULL;
+}
@@ -5,88 +5,326 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
 
 Layer layer_create(uint32_t input_size, ActivationFunction activation_function, uint32_t output_size) {
-    Layer layer = {
+    return (Layer){
         .input_size = input_size,
+        .biases = NULL,
+        .weights = NULL,
         .output_size = output_size,
         .activation_function = activation_function,
+        .plan = {0},
+        .precision = DOUBLE_PRECISION,
+        .compact_weights = NULL,
     };
+}
 
-    layer.biases = (double *)malloc(sizeof(double) * output_size);
-    double **weights = (double **)malloc(sizeof(double *) * input_size);
-    if (!weights || !layer.biases) {
-        fprintf(stderr, "ERROR: malloc() failed at layer_create()\n");
-        exit(EXIT_FAILURE);
+static inline int layer_threads(int planned_threads) {
+    return (planned_threads > 0) ? planned_threads : omp_get_max_threads();
+}
+
+size_t layer_memory_size(Layer *layer) {
+    return arena_aligned_size(sizeof(double) * layer->input_size * layer->output_size) + arena_aligned_size(sizeof(double) * layer->output_size);
+}
+
+void layer_allocate(Layer *layer, Arena *arena) {
+    layer->weights = (double *)arena_allocate(arena, sizeof(double) * layer->input_size * layer->output_size);
+    layer->biases = (double *)arena_allocate(arena, sizeof(double) * layer->output_size);
+}
+
+// Same static partition as the forward kernels, so each thread's rows are placed on its node
+void layer_first_touch(Layer *layer, const Layer *source) {
+#pragma omp parallel for schedule(static) num_threads(layer_threads(layer->plan.forward_threads))
+    for (uint32_t i = 0; i < layer->output_size; i++) {
+        double *weights = &layer->weights[(size_t)i * layer->input_size];
+        if (source) {
+            memcpy(weights, &source->weights[(size_t)i * layer->input_size], sizeof(double) * layer->input_size);
+            layer->biases[i] = source->biases[i];
+        } else {
+            memset(weights, 0, sizeof(double) * layer->input_size);
+            layer->biases[i] = 0.0;
+        }
     }
+}
+
+void layer_initialize(Layer *layer, WeightInitialization initialization, RandomStream *stream) {
+    uint64_t biases_counter = (uint64_t)layer->input_size * layer->output_size;
+    double limit;
 
-    for (uint32_t i = 0; i < input_size; i++) {
-        weights[i] = (double *)malloc(sizeof(double) * output_size);
-        if (!weights[i]) {
-            fprintf(stderr, "ERROR: malloc() failed at layer_create()\n");
+    switch (initialization) {
+        case UNIFORM_INITIALIZATION:
+#pragma omp parallel for schedule(static)
+            for (uint32_t i = 0; i < layer->output_size; i++) {
+                double *weights = &layer->weights[(size_t)i * layer->input_size];
+                for (uint32_t j = 0; j < layer->input_size; j++) {
+                    weights[j] = random_uniform(stream, (uint64_t)i * layer->input_size + j, -1.0, 1.0);
+                }
+                layer->biases[i] = random_uniform(stream, biases_counter + i, -1.0, 1.0);
+            }
+            return;
+        case XAVIER_INITIALIZATION:
+            limit = sqrt(6.0 / (layer->input_size + layer->output_size));
+#pragma omp parallel for schedule(static)
+            for (uint32_t i = 0; i < layer->output_size; i++) {
+                double *weights = &layer->weights[(size_t)i * layer->input_size];
+                for (uint32_t j = 0; j < layer->input_size; j++) {
+                    weights[j] = random_uniform(stream, (uint64_t)i * layer->input_size + j, -limit, limit);
+                }
+                layer->biases[i] = 0.0;
+            }
+            return;
+        case HE_INITIALIZATION:
+            limit = sqrt(2.0 / layer->input_size);
+#pragma omp parallel for schedule(static)
+            for (uint32_t i = 0; i < layer->output_size; i++) {
+                double *weights = &layer->weights[(size_t)i * layer->input_size];
+                for (uint32_t j = 0; j < layer->input_size; j++) {
+                    weights[j] = random_normal(stream, (uint64_t)i * layer->input_size + j, 0.0, limit);
+                }
+                layer->biases[i] = 0.0;
+            }
+            return;
+        default:
+            printf("ERROR at layer_initialize(): Unsupported weight initialization\n");
             exit(EXIT_FAILURE);
-        }
     }
-    layer.weights = weights;
+}
 
-    return layer;
+// bfloat16 is the upper half of a float, rounded to nearest even
+static inline uint16_t float_to_bfloat16(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(uint32_t));
+    return (uint16_t)((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
 }
 
-void layer_initialize(Layer *layer) {
-#pragma omp parallel for schedule(static)
+static inline float bfloat16_to_float(uint16_t value) {
+    uint32_t bits = (uint32_t)value << 16;
+    float result;
+    memcpy(&result, &bits, sizeof(float));
+    return result;
+}
+
+// IEEE half precision, rounded to nearest even, saturating to infinity
+static inline uint16_t float_to_float16(float value) {
+#ifdef __F16C__
+    return _cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+#else
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(uint32_t));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    bits &= 0x7FFFFFFF;
+
+    if (bits >= 0x47800000) {
+        // Too large for a half (or infinity, or NaN)
+        return sign | ((bits > 0x7F800000) ? 0x7E00 : 0x7C00);
+    }
+    if (bits < 0x38800000) {
+        // Subnormal half: adding 0.5 lets the FPU round the mantissa at 2^-24
+        float magnitude;
+        memcpy(&magnitude, &bits, sizeof(float));
+        magnitude += 0.5f;
+        memcpy(&bits, &magnitude, sizeof(uint32_t));
+        return sign | (uint16_t)(bits - 0x3F000000);
+    }
+
+    uint32_t odd = (bits >> 13) & 1;
+    bits += ((uint32_t)(15 - 127) << 23) + 0xFFF + odd;
+    return sign | (uint16_t)(bits >> 13);
+#endif
+}
+
+// Rebiases the exponent with a multiplication, which also handles subnormals
+static inline float float16_to_float(uint16_t value) {
+    uint32_t bits = (uint32_t)(value & 0x7FFF) << 13;
+    float magnitude;
+    memcpy(&magnitude, &bits, sizeof(float));
+    magnitude *= 0x1.0p112f;
+    memcpy(&bits, &magnitude, sizeof(uint32_t));
+    bits |= ((value & 0x7C00) == 0x7C00) ? 0x7F800000 : 0;
+    bits |= (uint32_t)(value & 0x8000) << 16;
+    float result;
+    memcpy(&result, &bits, sizeof(float));
+    return result;
+}
+
+void layer_compact(Layer *layer, WeightPrecision precision, uint16_t *compact_weights) {
+    layer->precision = precision;
+    layer->compact_weights = compact_weights;
+    if (precision == DOUBLE_PRECISION) {
+        return;
+    }
+
+    // Same static partition as the kernels, for the first touch of the rows
+#pragma omp parallel for schedule(static) num_threads(layer_threads(layer->plan.forward_threads))
     for (uint32_t i = 0; i < layer->output_size; i++) {
+        double *weights = &layer->weights[(size_t)i * layer->input_size];
+        uint16_t *compact = &compact_weights[(size_t)i * layer->input_size];
         for (uint32_t j = 0; j < layer->input_size; j++) {
-            layer->weights[j][i] = RANDOM(-1.0, 1.0);
+            compact[j] = (precision == BFLOAT16_PRECISION) ? float_to_bfloat16((float)weights[j]) : float_to_float16((float)weights[j]);
         }
-        layer->biases[i] = RANDOM(-1.0, 1.0);
     }
 }
 
+static inline float compact_to_float(WeightPrecision precision, uint16_t weight) {
+    return (precision == BFLOAT16_PRECISION) ? bfloat16_to_float(weight) : float16_to_float(weight);
+}
+
+// Dot product with a row of 16-bit weights, expanded to fp32 on the fly and accumulated in fp32
+static inline float layer_compact_dot(WeightPrecision precision, const uint16_t *weights, const double *input, uint32_t input_size) {
+    float sum = 0.0f;
+#pragma omp simd reduction(+ : sum)
+    for (uint32_t j = 0; j < input_size; j++) {
+        sum += (float)input[j] * compact_to_float(precision, weights[j]);
+    }
+    return sum;
+}
+
+#if defined(__F16C__) && defined(__AVX__)
+// Same as layer_compact_dot() for fp16 weights, expanding 8 weights at a time with F16C
+static inline float layer_float16_dot(const uint16_t *weights, const double *input, uint32_t input_size) {
+    __m256 sums = _mm256_setzero_ps();
+    uint32_t j = 0;
+    for (; j + 8 <= input_size; j += 8) {
+        __m256 w = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)&weights[j]));
+        __m256 x = _mm256_set_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(&input[j + 4])), _mm256_cvtpd_ps(_mm256_loadu_pd(&input[j])));
+        sums = _mm256_add_ps(sums, _mm256_mul_ps(x, w));
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, sums);
+    float sum = ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+    for (; j < input_size; j++) {
+        sum += (float)input[j] * _cvtsh_ss(weights[j]);
+    }
+    return sum;
+}
+#endif
+
+// compact_weights is NULL in double precision, so its rows are only indexed in the 16-bit branches
+static inline double layer_weighted_sum(Layer *layer, double *input, uint32_t i) {
+    if (layer->precision == BFLOAT16_PRECISION) {
+        uint16_t *compact_weights = &layer->compact_weights[(size_t)i * layer->input_size];
+        return layer->biases[i] + layer_compact_dot(BFLOAT16_PRECISION, compact_weights, input, layer->input_size);
+    }
+    if (layer->precision == FLOAT16_PRECISION) {
+        uint16_t *compact_weights = &layer->compact_weights[(size_t)i * layer->input_size];
+#if defined(__F16C__) && defined(__AVX__)
+        return layer->biases[i] + layer_float16_dot(compact_weights, input, layer->input_size);
+#else
+        return layer->biases[i] + layer_compact_dot(FLOAT16_PRECISION, compact_weights, input, layer->input_size);
+#endif
+    }
+
+    double *weights = &layer->weights[(size_t)i * layer->input_size];
+    double sum = 0.0;
+#pragma omp simd reduction(+ : sum)
+    for (uint32_t j = 0; j < layer->input_size; j++) {
+        sum += input[j] * weights[j];
+    }
+    return layer->biases[i] + sum;
+}
+
+static inline double layer_backpropagated_error(LayerBackwardContext *context, uint32_t output_size, uint32_t i) {
+    double error = 0.0;
+    for (uint32_t k = 0; k < context->next_layer_output_size; k++) {
+        error += context->next_layer_weights[(size_t)k * output_size + i] * context->next_layer_errors[k];
+    }
+    return error;
+}
+
 void layer_forward_linear(Layer *layer, double *input, double *output) {
-#pragma omp parallel for schedule(static)
+#pragma omp parallel for schedule(static) num_threads(layer_threads(layer->plan.forward_threads))
     for (uint32_t i = 0; i < layer->output_size; i++) {
-        double sum = layer->biases[i];
-        for (uint32_t j = 0; j < layer->input_size; j++) {
-            sum += input[j] * layer->weights[j][i];
-        }
-        output[i] = sum;
+        output[i] = layer_weighted_sum(layer, input, i);
     }
 }
 
 void layer_forward_sigmoid(Layer *layer, double *input, double *output) {
-#pragma omp parallel for schedule(static)
+#pragma omp parallel for schedule(static) num_threads(layer_threads(layer->plan.forward_threads))
     for (uint32_t i = 0; i < layer->output_size; i++) {
-        double sum = layer->biases[i];
-        for (uint32_t j = 0; j < layer->input_size; j++) {
-            sum += input[j] * layer->weights[j][i];
-        }
-        output[i] = sigmoid(sum);
+        output[i] = sigmoid(layer_weighted_sum(layer, input, i));
     }
 }
 
+// Returns the log-sum-exp
+static inline double softmax_normalize(double *values, uint32_t size) {
+    double maximum = values[0];
+    for (uint32_t i = 1; i < size; i++) {
+        maximum = (values[i] > maximum) ? values[i] : maximum;
+    }
+
+    double sum_exp = 0.0;
+    for (uint32_t i = 0; i < size; i++) {
+        values[i] = exp(values[i] - maximum);
+        sum_exp += values[i];
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        values[i] = values[i] / sum_exp;
+    }
+    return maximum + log(sum_exp);
+}
+
 void layer_forward_softmax(Layer *layer, double *input, double *output) {
+    double maximum = -INFINITY;
     double sum_exp = 0.0;
-    
-#pragma omp parallel
+
+#pragma omp parallel num_threads(layer_threads(layer->plan.forward_threads))
     {
-#pragma omp for schedule(static) reduction(+ : sum_exp)
+#pragma omp for schedule(static) reduction(max : maximum)
         for (uint32_t i = 0; i < layer->output_size; i++) {
-            double sum = layer->biases[i];
-            for (uint32_t j = 0; j < layer->input_size; j++) {
-                sum += input[j] * layer->weights[j][i];
-            }
+            output[i] = layer_weighted_sum(layer, input, i);
+            maximum = (output[i] > maximum) ? output[i] : maximum;
+        }
 
-            output[i] = exp(sum);
+#pragma omp for schedule(static) reduction(+ : sum_exp)
+        for (uint32_t i = 0; i < layer->output_size; i++) {
+            output[i] = exp(output[i] - maximum);
             sum_exp += output[i];
         }
 
-#pragma omp barrier
+#pragma omp for schedule(static)
+        for (uint32_t i = 0; i < layer->output_size; i++) {
+            output[i] = output[i] / sum_exp;
+        }
+    }
+}
+
+// Writes the probabilities and the errors p - one_hot(label), returns -log(p[label])
+double layer_forward_softmax_cross_entropy(Layer *layer, double *input, uint32_t label, double *output, double *errors) {
+    double maximum = -INFINITY;
+    double sum_exp = 0.0;
+    double label_logit = 0.0;
+
+#pragma omp parallel num_threads(layer_threads(layer->plan.forward_threads))
+    {
+#pragma omp for schedule(static) reduction(max : maximum)
+        for (uint32_t i = 0; i < layer->output_size; i++) {
+            output[i] = layer_weighted_sum(layer, input, i);
+            maximum = (output[i] > maximum) ? output[i] : maximum;
+        }
+
+#pragma omp single
+        label_logit = output[label];
+
+#pragma omp for schedule(static) reduction(+ : sum_exp)
+        for (uint32_t i = 0; i < layer->output_size; i++) {
+            output[i] = exp(output[i] - maximum);
+            sum_exp += output[i];
+        }
 
 #pragma omp for schedule(static)
         for (uint32_t i = 0; i < layer->output_size; i++) {
             output[i] = output[i] / sum_exp;
+            errors[i] = output[i] - ((i == label) ? 1.0 : 0.0);
         }
     }
+
+    return maximum + log(sum_exp) - label_logit;
 }
 
 void layer_forward(Layer *layer, double *input, double *output) {
@@ -106,65 +344,163 @@ void layer_forward(Layer *layer, double *input, double *output) {
     }
 }
 
-void layer_backward_linear(Layer *layer, LayerBackwardContext *context) {
-#pragma omp parallel
-    {
-        if (context->hidden_layer) {
-#pragma omp for schedule(static)
-            for (uint32_t i = 0; i < layer->output_size; i++) {
-                context->layer_errors[i] = 0.0;
-                for (uint32_t j = 0; j < context->next_layer_output_size; j++) {
-                    context->layer_errors[i] += layer->weights[i][j] * context->next_layer_errors[j];
-                }
-            }
-        } else {
-#pragma omp for schedule(static)
-            for (uint32_t i = 0; i < layer->output_size; i++) {
-                double target = (i == context->label) ? 1.0 : 0.0;
-                context->layer_errors[i] = (context->output[i] - target);
-            }
+static inline double layer_activate(ActivationFunction activation_function, double x) {
+    return (activation_function == SIGMOID_ACTIVATION) ? sigmoid(x) : x;
+}
+
+// Softmax epilogue of the tile kernels, with the cross-entropy of each sample when labeled
+static inline void layer_tile_softmax(double *outputs, uint32_t tile_size, uint32_t output_size, const uint8_t *labels, double *losses) {
+    for (uint32_t s = 0; s < tile_size; s++) {
+        double *output = &outputs[(size_t)s * output_size];
+        double label_logit = labels ? output[labels[s]] : 0.0;
+        double log_sum_exp = softmax_normalize(output, output_size);
+        if (labels) {
+            losses[s] = log_sum_exp - label_logit;
         }
+    }
+}
 
-#pragma omp barrier
+// Weights expanded to fp32, dot products accumulated in fp32
+static inline void layer_forward_tile_compact(Layer *layer, WeightPrecision precision, double *inputs, uint32_t tile_size, const uint8_t *labels, double *outputs, double *losses) {
+    uint32_t input_size = layer->input_size;
+    uint32_t output_size = layer->output_size;
+    ActivationFunction activation_function = layer->activation_function;
+    uint32_t block_end = (layer->plan.tile_block == 1) ? 0 : tile_size - tile_size % LAYER_TILE_BLOCK;
+
+    for (uint32_t i = 0; i < output_size; i++) {
+        uint16_t *weights = &layer->compact_weights[(size_t)i * input_size];
+        double bias = layer->biases[i];
+
+        for (uint32_t s = 0; s < block_end; s += LAYER_TILE_BLOCK) {
+            double *x0 = &inputs[(size_t)(s + 0) * input_size];
+            double *x1 = &inputs[(size_t)(s + 1) * input_size];
+            double *x2 = &inputs[(size_t)(s + 2) * input_size];
+            double *x3 = &inputs[(size_t)(s + 3) * input_size];
+            float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+#pragma omp simd reduction(+ : sum0, sum1, sum2, sum3)
+            for (uint32_t j = 0; j < input_size; j++) {
+                float weight = compact_to_float(precision, weights[j]);
+                sum0 += (float)x0[j] * weight;
+                sum1 += (float)x1[j] * weight;
+                sum2 += (float)x2[j] * weight;
+                sum3 += (float)x3[j] * weight;
+            }
+            outputs[(size_t)(s + 0) * output_size + i] = layer_activate(activation_function, bias + sum0);
+            outputs[(size_t)(s + 1) * output_size + i] = layer_activate(activation_function, bias + sum1);
+            outputs[(size_t)(s + 2) * output_size + i] = layer_activate(activation_function, bias + sum2);
+            outputs[(size_t)(s + 3) * output_size + i] = layer_activate(activation_function, bias + sum3);
+        }
 
-#pragma omp for schedule(static)
-        for (uint32_t i = 0; i < layer->output_size; i++) {
-            layer->biases[i] += context->learning_rate * context->layer_errors[i];
-            for (uint32_t j = 0; j < layer->input_size; j++) {
-                layer->weights[j][i] -= context->learning_rate * context->input[j] * context->layer_errors[i];
+        for (uint32_t s = block_end; s < tile_size; s++) {
+            double *x = &inputs[(size_t)s * input_size];
+            float sum = 0.0f;
+#pragma omp simd reduction(+ : sum)
+            for (uint32_t j = 0; j < input_size; j++) {
+                sum += (float)x[j] * compact_to_float(precision, weights[j]);
             }
+            outputs[(size_t)s * output_size + i] = layer_activate(activation_function, bias + sum);
         }
     }
+
+    if (activation_function == SOFTMAX_ACTIVATION) {
+        layer_tile_softmax(outputs, tile_size, output_size, labels, losses);
+    }
 }
 
-void layer_backward_sigmoid(Layer *layer, LayerBackwardContext *context) {
-#pragma omp parallel
-    {
-        if (context->hidden_layer) {
-#pragma omp for schedule(static)
-            for (uint32_t i = 0; i < layer->output_size; i++) {
-                context->layer_errors[i] = 0.0;
-                for (uint32_t j = 0; j < context->next_layer_output_size; j++) {
-                    context->layer_errors[i] += layer->weights[i][j] * context->next_layer_errors[j];
-                }
-                context->layer_errors[i] *= sigmoid_derivative(context->output[i]);
+// Each weights row is loaded once for tile_block samples
+static void layer_forward_tile_labeled(Layer *layer, double *inputs, uint32_t tile_size, const uint8_t *labels, double *outputs, double *losses) {
+    if (layer->precision == BFLOAT16_PRECISION) {
+        layer_forward_tile_compact(layer, BFLOAT16_PRECISION, inputs, tile_size, labels, outputs, losses);
+        return;
+    }
+    if (layer->precision == FLOAT16_PRECISION) {
+        layer_forward_tile_compact(layer, FLOAT16_PRECISION, inputs, tile_size, labels, outputs, losses);
+        return;
+    }
+
+    uint32_t input_size = layer->input_size;
+    uint32_t output_size = layer->output_size;
+    ActivationFunction activation_function = layer->activation_function;
+    uint32_t block_end = (layer->plan.tile_block == 1) ? 0 : tile_size - tile_size % LAYER_TILE_BLOCK;
+
+    for (uint32_t i = 0; i < output_size; i++) {
+        double *weights = &layer->weights[(size_t)i * input_size];
+        double bias = layer->biases[i];
+
+        for (uint32_t s = 0; s < block_end; s += LAYER_TILE_BLOCK) {
+            double *x0 = &inputs[(size_t)(s + 0) * input_size];
+            double *x1 = &inputs[(size_t)(s + 1) * input_size];
+            double *x2 = &inputs[(size_t)(s + 2) * input_size];
+            double *x3 = &inputs[(size_t)(s + 3) * input_size];
+            double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+#pragma omp simd reduction(+ : sum0, sum1, sum2, sum3)
+            for (uint32_t j = 0; j < input_size; j++) {
+                sum0 += x0[j] * weights[j];
+                sum1 += x1[j] * weights[j];
+                sum2 += x2[j] * weights[j];
+                sum3 += x3[j] * weights[j];
             }
-        } else {
-#pragma omp for schedule(static)
-            for (uint32_t i = 0; i < layer->output_size; i++) {
-                double target = (i == context->label) ? 1.0 : 0.0;
-                context->layer_errors[i] = (context->output[i] - target) * sigmoid_derivative(context->output[i]);
+            outputs[(size_t)(s + 0) * output_size + i] = layer_activate(activation_function, bias + sum0);
+            outputs[(size_t)(s + 1) * output_size + i] = layer_activate(activation_function, bias + sum1);
+            outputs[(size_t)(s + 2) * output_size + i] = layer_activate(activation_function, bias + sum2);
+            outputs[(size_t)(s + 3) * output_size + i] = layer_activate(activation_function, bias + sum3);
+        }
+
+        for (uint32_t s = block_end; s < tile_size; s++) {
+            double *x = &inputs[(size_t)s * input_size];
+            double sum = 0.0;
+#pragma omp simd reduction(+ : sum)
+            for (uint32_t j = 0; j < input_size; j++) {
+                sum += x[j] * weights[j];
             }
+            outputs[(size_t)s * output_size + i] = layer_activate(activation_function, bias + sum);
         }
+    }
+
+    if (activation_function == SOFTMAX_ACTIVATION) {
+        layer_tile_softmax(outputs, tile_size, output_size, labels, losses);
+    }
+}
 
-#pragma omp barrier
+void layer_forward_tile(Layer *layer, double *inputs, uint32_t tile_size, double *outputs) {
+    layer_forward_tile_labeled(layer, inputs, tile_size, NULL, outputs, NULL);
+}
 
-#pragma omp for schedule(static)
+// Losses from the log-sum-exp, as the probabilities underflow for confidently wrong samples
+void layer_forward_tile_cross_entropy(Layer *layer, double *inputs, uint32_t tile_size, const uint8_t *labels, double *outputs, double *losses) {
+    if (layer->activation_function != SOFTMAX_ACTIVATION) {
+        fprintf(stderr, "ERROR: Cross-entropy is only supported on softmax layers\n");
+        exit(EXIT_FAILURE);
+    }
+    layer_forward_tile_labeled(layer, inputs, tile_size, labels, outputs, losses);
+}
+
+void layer_backward_linear(Layer *layer, LayerBackwardContext *context) {
+    if (context->hidden_layer) {
+#pragma omp parallel for schedule(static) num_threads(layer_threads(layer->plan.backward_threads))
         for (uint32_t i = 0; i < layer->output_size; i++) {
-            layer->biases[i] += context->learning_rate * context->layer_errors[i];
-            for (uint32_t j = 0; j < layer->input_size; j++) {
-                layer->weights[j][i] -= context->learning_rate * context->input[j] * context->layer_errors[i];
-            }
+            context->layer_errors[i] = layer_backpropagated_error(context, layer->output_size, i);
+        }
+    } else {
+#pragma omp parallel for schedule(static) num_threads(layer_threads(layer->plan.backward_threads))
+        for (uint32_t i = 0; i < layer->output_size; i++) {
+            double target = (i == context->label) ? 1.0 : 0.0;
+            context->layer_errors[i] = (context->output[i] - target);
+        }
+    }
+}
+
+void layer_backward_sigmoid(Layer *layer, LayerBackwardContext *context) {
+    if (context->hidden_layer) {
+#pragma omp parallel for schedule(static) num_threads(layer_threads(layer->plan.backward_threads))
+        for (uint32_t i = 0; i < layer->output_size; i++) {
+            context->layer_errors[i] = layer_backpropagated_error(context, layer->output_size, i) * sigmoid_derivative(context->output[i]);
+        }
+    } else {
+#pragma omp parallel for schedule(static) num_threads(layer_threads(layer->plan.backward_threads))
+        for (uint32_t i = 0; i < layer->output_size; i++) {
+            double target = (i == context->label) ? 1.0 : 0.0;
+            context->layer_errors[i] = (context->output[i] - target) * sigmoid_derivative(context->output[i]);
         }
     }
 }
@@ -175,23 +511,12 @@ void layer_backward_softmax(Layer *layer, LayerBackwardContext *context) {
         exit(EXIT_FAILURE);
     }
 
-#pragma omp parallel
-    {
-#pragma omp for schedule(static)
+    if (!context->errors_ready) {
+#pragma omp parallel for schedule(static) num_threads(layer_threads(layer->plan.backward_threads))
         for (uint32_t i = 0; i < layer->output_size; i++) {
             double target = (i == context->label) ? 1.0 : 0.0;
             context->layer_errors[i] = (context->output[i] - target);
         }
-
-#pragma omp barrier
-
-#pragma omp for schedule(static)
-        for (uint32_t i = 0; i < layer->output_size; i++) {
-            layer->biases[i] += context->learning_rate * context->layer_errors[i];
-            for (uint32_t j = 0; j < layer->input_size; j++) {
-                layer->weights[j][i] -= context->learning_rate * context->input[j] * context->layer_errors[i];
-            }
-        }
     }
 }
 
@@ -212,20 +537,23 @@ void layer_backward(Layer *layer, LayerBackwardContext *context) {
     }
 }
 
-void layer_destroy(Layer *layer) {
-    free(layer->biases);
-    for (uint32_t i = 0; i < layer->input_size; i++) {
-        free(layer->weights[i]);
+void layer_update(Layer *layer, LayerBackwardContext *context) {
+#pragma omp parallel for schedule(static) num_threads(layer_threads(layer->plan.backward_threads))
+    for (uint32_t i = 0; i < layer->output_size; i++) {
+        double *weights = &layer->weights[(size_t)i * layer->input_size];
+        double step = context->learning_rate * context->layer_errors[i];
+        layer->biases[i] -= step;
+#pragma omp simd
+        for (uint32_t j = 0; j < layer->input_size; j++) {
+            weights[j] -= step * context->input[j];
+        }
     }
-    free(layer->weights);
 }
 
 int layer_save(Layer *layer, FILE *file) {
     size_t res = 1;
-    for (uint32_t i = 0; i < layer->output_size; i++) {
-        for (uint32_t j = 0; j < layer->input_size; j++) {
-            res = (res == 1) ? fwrite(&layer->weights[j][i], sizeof(double), 1, file) : res;
-        }
+    for (uint32_t i = 0; i < layer->output_size && res == 1; i++) {
+        res = (fwrite(&layer->weights[(size_t)i * layer->input_size], sizeof(double), layer->input_size, file) == layer->input_size) ? 1 : 0;
         res = (res == 1) ? fwrite(&layer->biases[i], sizeof(double), 1, file) : res;
     }
 
@@ -239,10 +567,8 @@ int layer_save(Layer *layer, FILE *file) {
 
 int layer_load(Layer *layer, FILE *file) {
     size_t res = 1;
-    for (uint32_t i = 0; i < layer->output_size; i++) {
-        for (uint32_t j = 0; j < layer->input_size; j++) {
-            res = (res == 1) ? fread(&layer->weights[j][i], sizeof(double), 1, file) : res;
-        }
+    for (uint32_t i = 0; i < layer->output_size && res == 1; i++) {
+        res = (fread(&layer->weights[(size_t)i * layer->input_size], sizeof(double), layer->input_size, file) == layer->input_size) ? 1 : 0;
         res = (res == 1) ? fread(&layer->biases[i], sizeof(double), 1, file) : res;
     }
 
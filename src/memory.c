@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+
+#include "memory.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define MAX_NUMA_NODES 64
+#define PAGE_SIZE 4096UL
+#define CPULIST_LENGTH 1024
+
+// Kept out of the mappings, so that no header first touches their first page
+typedef struct mapping {
+    void *memory;
+    size_t size;
+    struct mapping *next;
+} Mapping;
+
+static Mapping *mappings = NULL;
+static pthread_mutex_t mappings_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t round_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+static void *memory_map(size_t size) {
+    uint8_t *memory;
+    size_t mapping_size;
+
+    if (size >= HUGE_PAGE_SIZE) {
+        mapping_size = round_up(size, HUGE_PAGE_SIZE);
+        memory = (uint8_t *)mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory == MAP_FAILED) {
+            memory = (uint8_t *)mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory != MAP_FAILED) {
+                madvise(memory, mapping_size, MADV_HUGEPAGE);
+            }
+        }
+    } else {
+        mapping_size = round_up(size, PAGE_SIZE);
+        memory = (uint8_t *)mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+
+    if (memory == MAP_FAILED) {
+        perror("mmap() failed at memory_map()");
+        exit(EXIT_FAILURE);
+    }
+
+    Mapping *mapping = (Mapping *)malloc(sizeof(Mapping));
+    if (!mapping) {
+        fprintf(stderr, "ERROR: malloc() failed at memory_map()\n");
+        exit(EXIT_FAILURE);
+    }
+    mapping->memory = memory;
+    mapping->size = mapping_size;
+    pthread_mutex_lock(&mappings_mutex);
+    mapping->next = mappings;
+    mappings = mapping;
+    pthread_mutex_unlock(&mappings_mutex);
+
+    return memory;
+}
+
+void *memory_allocate(size_t size) {
+    if (size >= MEMORY_MAPPING_THRESHOLD) {
+        return memory_map(size);
+    }
+
+    void *memory = aligned_alloc(MEMORY_ALIGNMENT, round_up((size > 0) ? size : 1, MEMORY_ALIGNMENT));
+    if (!memory) {
+        fprintf(stderr, "ERROR: aligned_alloc() failed at memory_allocate()\n");
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+void memory_free(void *memory) {
+    if (!memory) {
+        return;
+    }
+
+    pthread_mutex_lock(&mappings_mutex);
+    Mapping **link = &mappings;
+    while (*link && (*link)->memory != memory) {
+        link = &(*link)->next;
+    }
+    Mapping *mapping = *link;
+    if (mapping) {
+        *link = mapping->next;
+    }
+    pthread_mutex_unlock(&mappings_mutex);
+
+    if (mapping) {
+        munmap(mapping->memory, mapping->size);
+        free(mapping);
+    } else {
+        free(memory);
+    }
+}
+
+// ****************************** NUMA ******************************
+
+static int number_of_nodes = 1;
+static int cpus_nodes[CPU_SETSIZE];
+static cpu_set_t nodes_cpus[MAX_NUMA_NODES];
+static pthread_once_t topology_once = PTHREAD_ONCE_INIT;
+
+static bool read_node_cpus(int node, cpu_set_t *cpus) {
+    char filename[64];
+    char cpulist[CPULIST_LENGTH];
+    snprintf(filename, sizeof(filename), "/sys/devices/system/node/node%d/cpulist", node);
+
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        return false;
+    }
+    bool read = fgets(cpulist, sizeof(cpulist), file) != NULL;
+    fclose(file);
+    if (!read) {
+        return false;
+    }
+
+    // Format: "0-3,8-11"
+    CPU_ZERO(cpus);
+    char *range = strtok(cpulist, ",\n");
+    while (range) {
+        int first, last;
+        int fields = sscanf(range, "%d-%d", &first, &last);
+        last = (fields == 2) ? last : first;
+        for (int cpu = first; fields >= 1 && cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+        range = strtok(NULL, ",\n");
+    }
+    return true;
+}
+
+static void read_topology(void) {
+    memset(cpus_nodes, 0, sizeof(cpus_nodes));
+
+    int node = 0;
+    while (node < MAX_NUMA_NODES && read_node_cpus(node, &nodes_cpus[node])) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &nodes_cpus[node])) {
+                cpus_nodes[cpu] = node;
+            }
+        }
+        node++;
+    }
+    number_of_nodes = (node > 0) ? node : 1;
+}
+
+int memory_numa_nodes(void) {
+    pthread_once(&topology_once, read_topology);
+    return number_of_nodes;
+}
+
+int memory_current_node(void) {
+    pthread_once(&topology_once, read_topology);
+    int cpu = sched_getcpu();
+    return (cpu >= 0 && cpu < CPU_SETSIZE) ? cpus_nodes[cpu] : 0;
+}
+
+typedef struct replication {
+    const void *source;
+    size_t size;
+    int node;
+    void *replica;
+} Replication;
+
+static void *replicate(void *argument) {
+    Replication *replication = (Replication *)argument;
+
+    // Pinned to the node, so that the copy first-touches the replica pages there
+    if (replication->node < MAX_NUMA_NODES && CPU_COUNT(&nodes_cpus[replication->node]) > 0) {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &nodes_cpus[replication->node]);
+    }
+    // Mapped whatever its size, as small heap blocks may share pages already placed elsewhere
+    replication->replica = memory_map(replication->size);
+    memcpy(replication->replica, replication->source, replication->size);
+    return NULL;
+}
+
+void *memory_replicate_on_node(const void *source, size_t size, int node) {
+    pthread_once(&topology_once, read_topology);
+
+    Replication replication = {
+        .source = source,
+        .size = size,
+        .node = node,
+        .replica = NULL,
+    };
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, replicate, &replication) != 0) {
+        fprintf(stderr, "ERROR: pthread_create() failed at memory_replicate_on_node()\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_join(thread, NULL);
+
+    return replication.replica;
+}
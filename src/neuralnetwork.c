@@ -1,54 +1,140 @@
 #include "neuralnetwork.h"
 
 #include <assert.h>
+#include <float.h>
 #include <math.h>
+#include <omp.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <unistd.h>
+
+#include "augmentation.h"
+#include "checkpoint.h"
+#include "memory.h"
 
 NeuralNetwork neuralnetwork_create(uint16_t number_of_layers) {
-    return (NeuralNetwork){
+    assert(number_of_layers > 0);
+
+    NeuralNetwork network = {
         .layers_capacity = number_of_layers,
         .layers_size = 0,
-        .layers = NULL,
         .layers_outputs = NULL,
+        .arena = {0},
+        .parameters_size = 0,
+        .tile_size = FORWARD_TILE_SIZE,
+        .number_of_replicas = 0,
+        .replicas = NULL,
+        .precision = DOUBLE_PRECISION,
+        .compact_weights = NULL,
     };
+
+    network.layers = (Layer *)malloc(number_of_layers * sizeof(Layer));
+    if (!network.layers) {
+        fprintf(stderr, "ERROR: malloc() failed at neuralnetwork_create()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return network;
+}
+
+// The parameters are copied from source_layers when given, zeroed otherwise
+static void neuralnetwork_allocate(NeuralNetwork *network, const Layer *source_layers) {
+    size_t capacity = arena_aligned_size(network->layers_size * sizeof(double *));
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        capacity += layer_memory_size(&network->layers[i]);
+        capacity += arena_aligned_size(network->layers[i].output_size * sizeof(double));
+    }
+
+    network->arena = arena_create(capacity);
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        layer_allocate(&network->layers[i], &network->arena);
+        layer_first_touch(&network->layers[i], source_layers ? &source_layers[i] : NULL);
+    }
+    network->parameters_size = network->arena.size;
+    network->layers_outputs = (double **)arena_allocate(&network->arena, network->layers_size * sizeof(double *));
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        network->layers_outputs[i] = (double *)arena_allocate(&network->arena, network->layers[i].output_size * sizeof(double));
+    }
 }
 
 void neuralnetwork_add_layer(NeuralNetwork *network, uint32_t input_size, ActivationFunction activation_function, uint32_t output_size) {
     assert(network->layers_size < network->layers_capacity);
 
-    if (!network->layers) {
-        network->layers = (Layer *)malloc(network->layers_capacity * sizeof(Layer));
-        if (!network->layers) {
-            fprintf(stderr, "ERROR: malloc() failed at neuralnetwork_add_layer()\n");
-            exit(EXIT_FAILURE);
-        }
+    network->layers[network->layers_size] = layer_create(input_size, activation_function, output_size);
+    network->layers_size += 1;
+
+    if (network->layers_size == network->layers_capacity) {
+        neuralnetwork_allocate(network, NULL);
     }
-    if (!network->layers_outputs) {
-        network->layers_outputs = (double **)malloc(network->layers_capacity * sizeof(double *));
-        if (!network->layers_outputs) {
-            fprintf(stderr, "ERROR: malloc() failed at neuralnetwork_add_layer()\n");
-            exit(EXIT_FAILURE);
-        }
+}
+
+void neuralnetwork_initialize(NeuralNetwork *network, WeightInitialization initialization, uint64_t seed) {
+    assert(network->layers_size == network->layers_capacity);
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        RandomStream stream = random_stream(seed, i);
+        layer_initialize(&network->layers[i], initialization, &stream);
     }
+}
 
-    network->layers[network->layers_size] = layer_create(input_size, activation_function, output_size);
-    network->layers_outputs[network->layers_size] = (double *)malloc(output_size * sizeof(double));
-    if (!network->layers_outputs[network->layers_size]) {
-        fprintf(stderr, "ERROR: malloc() failed at neuralnetwork_add_layer()\n");
+void neuralnetwork_replicate(NeuralNetwork *network) {
+    int number_of_nodes = memory_numa_nodes();
+    if (number_of_nodes < 2 || network->replicas) {
+        return;
+    }
+
+    network->replicas = (uint8_t **)malloc(number_of_nodes * sizeof(uint8_t *));
+    if (!network->replicas) {
+        fprintf(stderr, "ERROR: malloc() failed at neuralnetwork_replicate()\n");
         exit(EXIT_FAILURE);
     }
-    network->layers_size += 1;
+    for (int node = 0; node < number_of_nodes; node++) {
+        network->replicas[node] = (uint8_t *)memory_replicate_on_node(network->arena.memory, network->parameters_size, node);
+    }
+    network->number_of_replicas = number_of_nodes;
+}
+
+// First touches the parameters again with the current plans of the layers
+void neuralnetwork_place(NeuralNetwork *network) {
+    assert(network->layers_size == network->layers_capacity);
+
+    Layer *source_layers = (Layer *)malloc(network->layers_size * sizeof(Layer));
+    if (!source_layers) {
+        fprintf(stderr, "ERROR: malloc() failed at neuralnetwork_place()\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(source_layers, network->layers, network->layers_size * sizeof(Layer));
+    Arena source_arena = network->arena;
+
+    neuralnetwork_allocate(network, source_layers);
+
+    arena_destroy(&source_arena);
+    free(source_layers);
 }
 
-void neuralnetwork_initialize(NeuralNetwork *network) {
-    srand(time(NULL));
+// DOUBLE_PRECISION goes back to the double weights
+void neuralnetwork_set_precision(NeuralNetwork *network, WeightPrecision precision) {
+    memory_free(network->compact_weights);
+    network->compact_weights = NULL;
+    network->precision = precision;
+
+    size_t size = 0;
+    if (precision != DOUBLE_PRECISION) {
+        for (uint16_t i = 0; i < network->layers_size; i++) {
+            size += arena_aligned_size(sizeof(uint16_t) * network->layers[i].input_size * network->layers[i].output_size);
+        }
+        network->compact_weights = (uint16_t *)memory_allocate(size);
+    }
+
+    uint8_t *compact = (uint8_t *)network->compact_weights;
     for (uint16_t i = 0; i < network->layers_size; i++) {
-        layer_initialize(&network->layers[i]);
+        Layer *layer = &network->layers[i];
+        layer_compact(layer, precision, compact ? (uint16_t *)compact : NULL);
+        if (compact) {
+            compact += arena_aligned_size(sizeof(uint16_t) * layer->input_size * layer->output_size);
+        }
     }
 }
 
@@ -62,6 +148,132 @@ void neuralnetwork_forward(NeuralNetwork *network, double *input) {
     }
 }
 
+// Cross-entropy for a softmax output, half the squared error otherwise
+static double output_loss(ActivationFunction activation_function, double *output, uint32_t size, uint32_t label) {
+    if (activation_function == SOFTMAX_ACTIVATION) {
+        return -log(fmax(output[label], DBL_MIN));
+    }
+
+    double loss = 0.0;
+    for (uint32_t i = 0; i < size; i++) {
+        double error = output[i] - ((i == label) ? 1.0 : 0.0);
+        loss += 0.5 * error * error;
+    }
+    return loss;
+}
+
+// Only reads the network, so concurrent calls are safe
+static void neuralnetwork_forward_tiles(NeuralNetwork *network, double *inputs, uint8_t *labels, uint32_t number_of_inputs, double *outputs, double *losses, uint32_t *answers) {
+    uint32_t input_size = neuralnetwork_input_size(network);
+    uint32_t output_size = neuralnetwok_output_size(network);
+    uint16_t last = network->layers_size - 1;
+    ActivationFunction activation_function = network->layers[last].activation_function;
+    uint32_t max_layer_size = 0;
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        max_layer_size = (network->layers[i].output_size > max_layer_size) ? network->layers[i].output_size : max_layer_size;
+    }
+    uint32_t tile_size = network->tile_size;
+    size_t scratch_size = sizeof(double) * tile_size * max_layer_size;
+    uint32_t number_of_tiles = (number_of_inputs + tile_size - 1) / tile_size;
+    int number_of_threads = omp_get_max_threads();
+
+    size_t layers_size = network->layers_size * sizeof(Layer);
+
+    Arena arena = arena_create(number_of_threads * (2 * arena_aligned_size(scratch_size) + arena_aligned_size(layers_size)));
+
+#pragma omp parallel num_threads(number_of_threads)
+    {
+        double *scratch[2];
+        Layer *layers;
+#pragma omp critical
+        {
+            scratch[0] = (double *)arena_allocate(&arena, scratch_size);
+            scratch[1] = (double *)arena_allocate(&arena, scratch_size);
+            layers = (Layer *)arena_allocate(&arena, layers_size);
+        }
+
+        // Read the parameters from the replica of this thread's NUMA node, if any
+        memcpy(layers, network->layers, layers_size);
+        int node = (network->number_of_replicas > 1) ? memory_current_node() : 0;
+        if (node < network->number_of_replicas) {
+            for (uint16_t i = 0; i < network->layers_size; i++) {
+                layers[i].weights = (double *)(network->replicas[node] + ((uint8_t *)network->layers[i].weights - network->arena.memory));
+                layers[i].biases = (double *)(network->replicas[node] + ((uint8_t *)network->layers[i].biases - network->arena.memory));
+            }
+        }
+
+#pragma omp for schedule(static)
+        for (uint32_t tile = 0; tile < number_of_tiles; tile++) {
+            uint32_t first = tile * tile_size;
+            uint32_t current_tile_size = (number_of_inputs - first < tile_size) ? number_of_inputs - first : tile_size;
+
+            for (uint32_t s = 0; labels && s < current_tile_size; s++) {
+                if (labels[first + s] >= output_size) {
+                    fprintf(stderr, "ERROR: Label %d out of the %d classes of the network\n", labels[first + s], output_size);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            double *layer_inputs = &inputs[(size_t)first * input_size];
+            double *layer_outputs = NULL;
+            for (uint16_t i = 0; i < network->layers_size; i++) {
+                layer_outputs = scratch[i % 2];
+                if (labels && i == last && activation_function == SOFTMAX_ACTIVATION) {
+                    layer_forward_tile_cross_entropy(&layers[i], layer_inputs, current_tile_size, &labels[first], layer_outputs, &losses[first]);
+                } else {
+                    layer_forward_tile(&layers[i], layer_inputs, current_tile_size, layer_outputs);
+                }
+                layer_inputs = layer_outputs;
+            }
+
+            if (labels && activation_function != SOFTMAX_ACTIVATION) {
+                for (uint32_t s = 0; s < current_tile_size; s++) {
+                    losses[first + s] = output_loss(activation_function, &layer_outputs[(size_t)s * output_size], output_size, labels[first + s]);
+                }
+            }
+
+            if (outputs) {
+                memcpy(&outputs[(size_t)first * output_size], layer_outputs, sizeof(double) * current_tile_size * output_size);
+            }
+            if (answers) {
+                for (uint32_t s = 0; s < current_tile_size; s++) {
+                    answers[first + s] = max_index(&layer_outputs[(size_t)s * output_size], output_size);
+                }
+            }
+        }
+    }
+
+    arena_destroy(&arena);
+}
+
+void neuralnetwork_forward_batch(NeuralNetwork *network, double *inputs, uint32_t number_of_inputs, double *outputs) {
+    neuralnetwork_forward_tiles(network, inputs, NULL, number_of_inputs, outputs, NULL, NULL);
+}
+
+void neuralnetwork_forward_batch_loss(NeuralNetwork *network, double *inputs, uint8_t *labels, uint32_t number_of_inputs, double *outputs, double *losses) {
+    neuralnetwork_forward_tiles(network, inputs, labels, number_of_inputs, outputs, losses, NULL);
+}
+
+// A softmax output also leaves the output errors ready for neuralnetwork_backward()
+double neuralnetwork_forward_loss(NeuralNetwork *network, double *input, BackwardContext *backward_context) {
+    uint16_t last = network->layers_size - 1;
+    Layer *output_layer = &network->layers[last];
+
+    if (output_layer->activation_function != SOFTMAX_ACTIVATION) {
+        neuralnetwork_forward(network, input);
+        backward_context->output_errors_ready = false;
+        return output_loss(output_layer->activation_function, network->layers_outputs[last], output_layer->output_size, backward_context->label);
+    }
+
+    double *layer_input = input;
+    for (uint16_t i = 0; i < last; i++) {
+        layer_forward(&network->layers[i], layer_input, network->layers_outputs[i]);
+        layer_input = network->layers_outputs[i];
+    }
+    backward_context->output_errors_ready = true;
+    return layer_forward_softmax_cross_entropy(output_layer, layer_input, backward_context->label, network->layers_outputs[last], backward_context->layers_errors[last]);
+}
+
 void neuralnetwork_backward(NeuralNetwork *network, double *input, BackwardContext *backward_context) {
     LayerBackwardContext layer_backward_context = {
         .learning_rate = backward_context->learning_rate,
@@ -73,12 +285,21 @@ void neuralnetwork_backward(NeuralNetwork *network, double *input, BackwardConte
         layer_backward_context.hidden_layer = (layer_index < network->layers_size - 1);
         layer_backward_context.input = (layer_index == 0) ? input : network->layers_outputs[layer_index - 1];
         layer_backward_context.output = network->layers_outputs[layer_index];
+        layer_backward_context.errors_ready = (layer_index == network->layers_size - 1) && backward_context->output_errors_ready;
         layer_backward_context.layer_errors = backward_context->layers_errors[layer_index];
         layer_backward_context.next_layer_output_size = (layer_index == network->layers_size - 1) ? 0 : network->layers[layer_index + 1].output_size;
+        layer_backward_context.next_layer_weights = (layer_index == network->layers_size - 1) ? NULL : network->layers[layer_index + 1].weights;
         layer_backward_context.next_layer_errors = (layer_index == network->layers_size - 1) ? NULL : backward_context->layers_errors[layer_index + 1];
 
         layer_backward(&network->layers[layer_index], &layer_backward_context);
     }
+
+    // Updates only once every layer errors were computed with the weights of the forward pass
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        layer_backward_context.input = (i == 0) ? input : network->layers_outputs[i - 1];
+        layer_backward_context.layer_errors = backward_context->layers_errors[i];
+        layer_update(&network->layers[i], &layer_backward_context);
+    }
 }
 
 BackwardContext backwardcontext_create(NeuralNetwork *network, double learning_rate) {
@@ -86,52 +307,207 @@ BackwardContext backwardcontext_create(NeuralNetwork *network, double learning_r
         .learning_rate = learning_rate,
         .label = 0,
         .number_of_layers = network->layers_size,
+        .output_errors_ready = false,
     };
-    backward_context.layers_errors = (double **)malloc(network->layers_size * sizeof(double *));
+
+    size_t capacity = arena_aligned_size(network->layers_size * sizeof(double *));
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        capacity += arena_aligned_size(network->layers[i].output_size * sizeof(double));
+    }
+
+    backward_context.arena = arena_create(capacity);
+    backward_context.layers_errors = (double **)arena_allocate(&backward_context.arena, network->layers_size * sizeof(double *));
     for (uint16_t i = 0; i < network->layers_size; i++) {
-        backward_context.layers_errors[i] = (double *)malloc(network->layers[i].output_size * sizeof(double));
+        backward_context.layers_errors[i] = (double *)arena_allocate(&backward_context.arena, network->layers[i].output_size * sizeof(double));
     }
 
     return backward_context;
 }
 
 void backwardcontext_destroy(BackwardContext *context) {
-    for (uint16_t i = 0; i < context->number_of_layers; i++) {
-        free(context->layers_errors[i]);
-    }
-    free(context->layers_errors);
+    arena_destroy(&context->arena);
+    context->layers_errors = NULL;
+}
+
+static bool patience_exhausted(TrainingContext *context) {
+    return context->patience > 0 && context->epochs_without_improvement >= context->patience;
 }
 
 void neuralnetwork_train(NeuralNetwork *network, double *inputs, uint8_t *labels, TrainingContext *training_context) {
+    if (network->precision != DOUBLE_PRECISION) {
+        fprintf(stderr, "ERROR: Cannot train a network with 16-bit weights, set it back to DOUBLE_PRECISION\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t output_size = neuralnetwok_output_size(network);
+    for (uint32_t i = 0; i < training_context->number_of_examples; i++) {
+        if (labels[i] >= output_size) {
+            fprintf(stderr, "ERROR: Label %d out of the %d classes of the network\n", labels[i], output_size);
+            exit(EXIT_FAILURE);
+        }
+    }
+
     BackwardContext backward_context = backwardcontext_create(network, training_context->learning_rate);
     uint32_t input_size = neuralnetwork_input_size(network);
 
-    double mse;
-    uint8_t prediction;
+    // A resumed training keeps the early stopping and plateau state of its checkpoint
+    bool resuming = training_context->epoch > 0 || training_context->example > 0;
+    if (!resuming) {
+        training_context->best_validation_accuracy = 0.0;
+        training_context->best_epoch = 0;
+        training_context->epochs_without_improvement = 0;
+        training_context->plateau_best_score = -1.0;
+        training_context->plateau_epochs = 0;
+    }
+
+    bool validation = training_context->validation_inputs && training_context->number_of_validation_examples > 0;
+    if (validation && training_context->best_parameters_size != network->parameters_size) {
+        free(training_context->best_parameters);
+        training_context->best_parameters = (uint8_t *)malloc(network->parameters_size);
+        training_context->best_parameters_size = network->parameters_size;
+        if (!training_context->best_parameters) {
+            fprintf(stderr, "ERROR: malloc() failed at neuralnetwork_train()\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    bool checkpointing = training_context->checkpoint_filename != NULL;
+    Checkpointer checkpointer;
+    if (checkpointing) {
+        checkpointer = checkpointer_create(training_context->checkpoint_filename);
+    }
+
+    Augmentation *augmentation = training_context->augmentation;
+    double *augmented_inputs = NULL;
+    uint32_t augmented_first = 0;
+    if (augmentation) {
+        if ((size_t)augmentation->width * augmentation->height != input_size) {
+            fprintf(stderr, "ERROR: The augmented images don't match the input size of the network\n");
+            exit(EXIT_FAILURE);
+        }
+        augmented_inputs = (double *)memory_allocate(sizeof(double) * AUGMENTATION_BATCH_SIZE * input_size);
+    }
+
+    double loss;
+    uint32_t prediction;
     double accuracy;
-    for (uint32_t epoch = 0; epoch < training_context->number_of_epochs; epoch++) {
-        printf("Running epoch %d/%d...\n", epoch + 1, training_context->number_of_epochs);
-        mse = 0.0;
-        for (uint32_t i = 0; i < training_context->number_of_examples; i++) {
+    // Also checked up front, for a training resumed after it stopped early
+    for (uint32_t epoch = training_context->epoch; epoch < training_context->number_of_epochs && !(validation && patience_exhausted(training_context)); epoch++) {
+        if (!training_context->quiet) {
+            printf("Running epoch %d/%d (learning rate %f)...\n", epoch + 1, training_context->number_of_epochs, trainingcontext_learning_rate(training_context));
+        }
+        loss = 0.0;
+        accuracy = 0.0;
+        uint32_t first_example = training_context->example;
+        for (uint32_t i = first_example; i < training_context->number_of_examples; i++) {
+            double *input;
+            if (augmentation) {
+                // Augment the next batch of images in parallel, ahead of its examples
+                if (i == first_example || i - augmented_first == AUGMENTATION_BATCH_SIZE) {
+                    uint32_t remaining = training_context->number_of_examples - i;
+                    augmented_first = i;
+                    augmentation_apply(augmentation, epoch, i, (remaining < AUGMENTATION_BATCH_SIZE) ? remaining : AUGMENTATION_BATCH_SIZE, augmented_inputs);
+                }
+                input = &augmented_inputs[(size_t)(i - augmented_first) * input_size];
+            } else {
+                input = &inputs[(size_t)i * input_size];
+            }
+
+            backward_context.learning_rate = trainingcontext_learning_rate(training_context);
             backward_context.label = labels[i];
-            prediction = neuralnetwork_ask(network, &inputs[i * input_size]);
-            neuralnetwork_backward(network, &inputs[i * input_size], &backward_context);
-            mse += (labels[i] - prediction) * (labels[i] - prediction);
+            loss += neuralnetwork_forward_loss(network, input, &backward_context);
+            prediction = max_index(neuralnetwork_output(network), output_size);
+            neuralnetwork_backward(network, input, &backward_context);
             accuracy += (labels[i] == prediction) ? 1.0 : 0.0;
+
+            training_context->example = i + 1;
+            // The end of the epoch is left to the epoch checkpoint, which also moves on to the next epoch
+            if (checkpointing && training_context->checkpoint_every_examples > 0 && training_context->example % training_context->checkpoint_every_examples == 0 &&
+                training_context->example < training_context->number_of_examples) {
+                checkpointer_snapshot(&checkpointer, network, training_context);
+            }
+        }
+        uint32_t epoch_examples = training_context->number_of_examples - first_example;
+        if (epoch_examples > 0) {
+            loss = loss / epoch_examples;
+            accuracy = accuracy / epoch_examples;
+        }
+        if (!training_context->quiet) {
+            printf("   Loss       = %f\n   Accuracy   = %f\n", loss, accuracy);
+        }
+
+        training_context->epoch = epoch + 1;
+        training_context->example = 0;
+
+        // An epoch is scored by its validation accuracy, or by its training accuracy without a validation set
+        double score = accuracy;
+        if (validation) {
+            score = neuralnetwork_benchmark(network, training_context->validation_inputs, training_context->validation_labels, training_context->number_of_validation_examples);
+            if (!training_context->quiet) {
+                printf("   Validation accuracy = %f\n", score);
+            }
+        }
+
+        // Lowered before the checkpoint, so that a resumed training keeps the reduction
+        if (training_context->schedule == PLATEAU_SCHEDULE) {
+            if (score > training_context->plateau_best_score) {
+                training_context->plateau_best_score = score;
+                training_context->plateau_epochs = 0;
+            } else if (++training_context->plateau_epochs >= training_context->decay_epochs) {
+                training_context->learning_rate = fmax(training_context->learning_rate * training_context->decay_rate, training_context->minimum_learning_rate);
+                training_context->plateau_epochs = 0;
+                if (!training_context->quiet) {
+                    printf("   Learning rate lowered to %f\n", training_context->learning_rate);
+                }
+            }
+        }
+
+        if (validation) {
+            if (training_context->best_epoch == 0 || score > training_context->best_validation_accuracy) {
+                training_context->best_validation_accuracy = score;
+                training_context->best_epoch = epoch + 1;
+                memcpy(training_context->best_parameters, network->arena.memory, network->parameters_size);
+                training_context->epochs_without_improvement = 0;
+            } else {
+                training_context->epochs_without_improvement++;
+            }
+        }
+
+        if (checkpointing && training_context->checkpoint_every_epochs > 0 && training_context->epoch % training_context->checkpoint_every_epochs == 0) {
+            checkpointer_snapshot(&checkpointer, network, training_context);
+        }
+
+        if (validation && patience_exhausted(training_context)) {
+            if (!training_context->quiet) {
+                printf("No improvement for %d epochs, stopping early\n", training_context->patience);
+            }
+            break;
+        }
+    }
+
+    if (checkpointing) {
+        checkpointer_destroy(&checkpointer);
+    }
+
+    if (validation && training_context->best_epoch > 0) {
+        memcpy(network->arena.memory, training_context->best_parameters, network->parameters_size);
+        if (!training_context->quiet) {
+            printf("Kept the weights of epoch %d (validation accuracy = %f)\n", training_context->best_epoch, training_context->best_validation_accuracy);
         }
-        mse = mse / training_context->number_of_examples;
-        accuracy = accuracy / training_context->number_of_examples;
-        printf("   Loss (MSE) = %f\n   Accuracy   = %f\n", mse, accuracy);
     }
+    free(training_context->best_parameters);
+    training_context->best_parameters = NULL;
+    training_context->best_parameters_size = 0;
+    memory_free(augmented_inputs);
 
     backwardcontext_destroy(&backward_context);
 }
 
-uint8_t max_index(double *array, uint8_t size) {
+uint32_t max_index(double *array, uint32_t size) {
     assert((size > 0 && array) || size == 0);
 
-    uint8_t max_index = 0;
-    for (uint8_t i = 0; i < size; i++) {
+    uint32_t max_index = 0;
+    for (uint32_t i = 0; i < size; i++) {
         if (array[i] > array[max_index]) {
             max_index = i;
         }
@@ -139,22 +515,51 @@ uint8_t max_index(double *array, uint8_t size) {
     return max_index;
 }
 
-uint8_t neuralnetwork_ask(NeuralNetwork *network, double *input) {
+uint32_t neuralnetwork_ask(NeuralNetwork *network, double *input) {
     neuralnetwork_forward(network, input);
     return max_index(neuralnetwork_output(network), neuralnetwok_output_size(network));
 }
 
+void neuralnetwork_ask_batch(NeuralNetwork *network, double *inputs, uint32_t number_of_inputs, uint32_t *answers) {
+    neuralnetwork_forward_tiles(network, inputs, NULL, number_of_inputs, NULL, NULL, answers);
+}
+
 double neuralnetwork_benchmark(NeuralNetwork *network, double *inputs, uint8_t *labels, uint32_t number_of_inputs) {
+    uint32_t *answers = (uint32_t *)malloc(number_of_inputs * sizeof(uint32_t));
+    if (!answers) {
+        fprintf(stderr, "ERROR: malloc() failed at neuralnetwork_benchmark()\n");
+        exit(EXIT_FAILURE);
+    }
+    neuralnetwork_ask_batch(network, inputs, number_of_inputs, answers);
+
     uint32_t correct_predictions = 0;
-    uint32_t input_size = neuralnetwork_input_size(network);
     for (uint32_t i = 0; i < number_of_inputs; i++) {
-        uint8_t answer = neuralnetwork_ask(network, &inputs[i * input_size]);
-        correct_predictions += (answer == labels[i]) ? 1 : 0;
+        correct_predictions += (answers[i] == labels[i]) ? 1 : 0;
     }
 
+    free(answers);
     return (double)correct_predictions / number_of_inputs;
 }
 
+double neuralnetwork_output_loss(NeuralNetwork *network, double *output, uint32_t label) {
+    Layer *output_layer = &network->layers[network->layers_size - 1];
+    return output_loss(output_layer->activation_function, output, output_layer->output_size, label);
+}
+
+double neuralnetwork_loss(NeuralNetwork *network, double *inputs, uint8_t *labels, uint32_t number_of_inputs) {
+    double *losses = (double *)memory_allocate(sizeof(double) * number_of_inputs);
+    neuralnetwork_forward_batch_loss(network, inputs, labels, number_of_inputs, NULL, losses);
+
+    double loss = 0.0;
+#pragma omp parallel for schedule(static) reduction(+ : loss)
+    for (uint32_t i = 0; i < number_of_inputs; i++) {
+        loss += losses[i];
+    }
+
+    memory_free(losses);
+    return loss / number_of_inputs;
+}
+
 uint32_t neuralnetwork_input_size(NeuralNetwork *network) {
     assert(network->layers_size > 0);
     return network->layers[0].input_size;
@@ -172,25 +577,26 @@ double *neuralnetwork_output(NeuralNetwork *network) {
 }
 
 void neuralnetwork_destroy(NeuralNetwork *network) {
-    for (uint16_t i = 0; i < network->layers_size; i++) {
-        free(network->layers_outputs[i]);
-        layer_destroy(&network->layers[i]);
+    for (uint16_t i = 0; i < network->number_of_replicas; i++) {
+        memory_free(network->replicas[i]);
     }
-    free(network->layers_outputs);
+    free(network->replicas);
+    network->replicas = NULL;
+    network->number_of_replicas = 0;
+
+    memory_free(network->compact_weights);
+    network->compact_weights = NULL;
+
+    arena_destroy(&network->arena);
     free(network->layers);
+    network->layers = NULL;
+    network->layers_outputs = NULL;
 }
 
-void neuralnetwork_save(NeuralNetwork *network, TrainingContext *context, const char *filename) {
-    FILE *file = fopen(filename, "wb");
-    if (!file) {
-        perror("fopen() failed at neuralnetwork_save()");
-        exit(EXIT_FAILURE);
-    }
-
+int neuralnetwork_write(NeuralNetwork *network, TrainingContext *context, FILE *file) {
     if (fwrite(&network->layers_size, sizeof(uint16_t), 1, file) != 1) {
-        fclose(file);
-        perror("fwrite() failed at neuralnetwork_save()");
-        exit(EXIT_FAILURE);
+        perror("fwrite() failed at neuralnetwork_write()");
+        return EXIT_FAILURE;
     }
 
     size_t res = 1;
@@ -199,18 +605,26 @@ void neuralnetwork_save(NeuralNetwork *network, TrainingContext *context, const
         res = (res == 1) ? fwrite(&network->layers[i].activation_function, sizeof(ActivationFunction), 1, file) : res;
         res = (res == 1) ? fwrite(&network->layers[i].output_size, sizeof(uint32_t), 1, file) : res;
         if (res != 1) {
-            fclose(file);
-            perror("fwrite() failed at neuralnetwork_save()");
-            exit(EXIT_FAILURE);
+            perror("fwrite() failed at neuralnetwork_write()");
+            return EXIT_FAILURE;
         }
 
         if (layer_save(&network->layers[i], file)) {
-            fclose(file);
-            exit(EXIT_FAILURE);
+            return EXIT_FAILURE;
         }
     }
 
-    if (trainingcontext_save(context, file)) {
+    return trainingcontext_save(context, file);
+}
+
+void neuralnetwork_save(NeuralNetwork *network, TrainingContext *context, const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        perror("fopen() failed at neuralnetwork_save()");
+        exit(EXIT_FAILURE);
+    }
+
+    if (neuralnetwork_write(network, context, file)) {
         fclose(file);
         exit(EXIT_FAILURE);
     }
@@ -232,7 +646,9 @@ void neuralnetwork_load(NeuralNetwork *network, TrainingContext *context, const
         exit(EXIT_FAILURE);
     }
 
+    // First pass reads the topology, so that the network arena can be sized up front
     *network = neuralnetwork_create(number_of_layers);
+    long weights_offset = ftell(file);
     size_t res = 1;
     uint32_t input_size;
     ActivationFunction activation_function;
@@ -241,13 +657,27 @@ void neuralnetwork_load(NeuralNetwork *network, TrainingContext *context, const
         res = (res == 1) ? fread(&input_size, sizeof(uint32_t), 1, file) : res;
         res = (res == 1) ? fread(&activation_function, sizeof(ActivationFunction), 1, file) : res;
         res = (res == 1) ? fread(&output_size, sizeof(uint32_t), 1, file) : res;
-        if (res != 1) {
+        if (res != 1 || fseek(file, (long)sizeof(double) * (input_size + 1) * output_size, SEEK_CUR)) {
             fclose(file);
-            perror("fwrite() failed at neuralnetwork_save()");
+            perror("fread() failed at neuralnetwork_load()");
             exit(EXIT_FAILURE);
         }
 
         neuralnetwork_add_layer(network, input_size, activation_function, output_size);
+    }
+
+    // Second pass reads the weights into the allocated layers
+    if (fseek(file, weights_offset, SEEK_SET)) {
+        fclose(file);
+        perror("fseek() failed at neuralnetwork_load()");
+        exit(EXIT_FAILURE);
+    }
+    for (uint16_t i = 0; i < number_of_layers; i++) {
+        if (fseek(file, (long)(2 * sizeof(uint32_t) + sizeof(ActivationFunction)), SEEK_CUR)) {
+            fclose(file);
+            perror("fseek() failed at neuralnetwork_load()");
+            exit(EXIT_FAILURE);
+        }
         if (layer_load(&network->layers[i], file)) {
             fclose(file);
             exit(EXIT_FAILURE);
@@ -261,3 +691,29 @@ void neuralnetwork_load(NeuralNetwork *network, TrainingContext *context, const
 
     fclose(file);
 }
+
+bool neuralnetwork_resume(NeuralNetwork *network, TrainingContext *context, const char *filename) {
+    if (access(filename, F_OK) != 0) {
+        return false;
+    }
+
+    TrainingContext saved_context;
+    neuralnetwork_load(network, &saved_context, filename);
+    context->learning_rate = saved_context.learning_rate;
+    context->epoch = saved_context.epoch;
+    context->example = saved_context.example;
+    context->best_validation_accuracy = saved_context.best_validation_accuracy;
+    context->best_epoch = saved_context.best_epoch;
+    context->epochs_without_improvement = saved_context.epochs_without_improvement;
+    context->plateau_best_score = saved_context.plateau_best_score;
+    context->plateau_epochs = saved_context.plateau_epochs;
+    context->best_parameters = saved_context.best_parameters;
+    context->best_parameters_size = saved_context.best_parameters_size;
+
+    if (context->epoch >= context->number_of_epochs) {
+        printf("Resumed from '%s' after the last epoch (%d/%d)\n", filename, context->epoch, context->number_of_epochs);
+    } else {
+        printf("Resumed from '%s' at epoch %d/%d, example %d\n", filename, context->epoch + 1, context->number_of_epochs, context->example);
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#include "random.h"
+
+#include <math.h>
+#include <stdint.h>
+
+#define GOLDEN_GAMMA 0x9E3779B97F4A7C15ULL
+
+static uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+RandomStream random_stream(uint64_t seed, uint64_t stream_id) {
+    return (RandomStream){
+        .key = mix64(seed ^ mix64((stream_id + 1) * GOLDEN_GAMMA)),
+    };
+}
+
+uint64_t random_uint64(RandomStream *stream, uint64_t counter) {
+    return mix64(stream->key + (counter + 1) * GOLDEN_GAMMA);
+}
+
+double random_uniform(RandomStream *stream, uint64_t counter, double min, double max) {
+    // 53 random bits mapped to [0, 1)
+    double unit = (random_uint64(stream, counter) >> 11) * 0x1.0p-53;
+    return (max - min) * unit + min;
+}
+
+double random_normal(RandomStream *stream, uint64_t counter, double mean, double standard_deviation) {
+    // Box-Muller transform, consuming counters 2 * counter and 2 * counter + 1
+    double u1 = 1.0 - random_uniform(stream, 2 * counter, 0.0, 1.0);
+    double u2 = random_uniform(stream, 2 * counter + 1, 0.0, 1.0);
+    return mean + standard_deviation * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
@@ -1,5 +1,6 @@
 #include "training.h"
 
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,9 +10,28 @@ int trainingcontext_save(TrainingContext *context, FILE *file) {
     res = (res == 1) ? fwrite(&context->learning_rate, sizeof(double), 1, file) : res;
     res = (res == 1) ? fwrite(&context->number_of_epochs, sizeof(uint32_t), 1, file) : res;
     res = (res == 1) ? fwrite(&context->number_of_examples, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->epoch, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->example, sizeof(uint32_t), 1, file) : res;
+    uint32_t schedule = context->schedule;
+    res = (res == 1) ? fwrite(&schedule, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->decay_rate, sizeof(double), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->decay_epochs, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->minimum_learning_rate, sizeof(double), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->warmup_examples, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->schedule_every_examples, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->plateau_best_score, sizeof(double), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->plateau_epochs, sizeof(uint32_t), 1, file) : res;
+    uint64_t best_parameters_size = context->best_parameters_size;
+    res = (res == 1) ? fwrite(&context->best_validation_accuracy, sizeof(double), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->best_epoch, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fwrite(&context->epochs_without_improvement, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fwrite(&best_parameters_size, sizeof(uint64_t), 1, file) : res;
+    if (res == 1 && best_parameters_size > 0) {
+        res = fwrite(context->best_parameters, best_parameters_size, 1, file);
+    }
 
     if (res != 1) {
-        perror("fwrite() failed at linearlayer_save()");
+        perror("fwrite() failed at trainingcontext_save()");
         return EXIT_FAILURE;
     }
 
@@ -19,15 +39,88 @@ int trainingcontext_save(TrainingContext *context, FILE *file) {
 }
 
 int trainingcontext_load(TrainingContext *context, FILE *file) {
+    *context = (TrainingContext){0};
+
     size_t res = 1;
     res = (res == 1) ? fread(&context->learning_rate, sizeof(double), 1, file) : res;
     res = (res == 1) ? fread(&context->number_of_epochs, sizeof(uint32_t), 1, file) : res;
     res = (res == 1) ? fread(&context->number_of_examples, sizeof(uint32_t), 1, file) : res;
 
     if (res != 1) {
-        perror("fread() failed at linearlayer_load()");
+        perror("fread() failed at trainingcontext_load()");
+        return EXIT_FAILURE;
+    }
+
+    // Models saved before the training progress was recorded end here
+    if (fread(&context->epoch, sizeof(uint32_t), 1, file) != 1) {
+        context->epoch = 0;
+        return feof(file) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    uint32_t schedule;
+    uint64_t best_parameters_size = 0;
+    res = 1;
+    res = (res == 1) ? fread(&context->example, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fread(&schedule, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fread(&context->decay_rate, sizeof(double), 1, file) : res;
+    res = (res == 1) ? fread(&context->decay_epochs, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fread(&context->minimum_learning_rate, sizeof(double), 1, file) : res;
+    res = (res == 1) ? fread(&context->warmup_examples, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fread(&context->schedule_every_examples, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fread(&context->plateau_best_score, sizeof(double), 1, file) : res;
+    res = (res == 1) ? fread(&context->plateau_epochs, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fread(&context->best_validation_accuracy, sizeof(double), 1, file) : res;
+    res = (res == 1) ? fread(&context->best_epoch, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fread(&context->epochs_without_improvement, sizeof(uint32_t), 1, file) : res;
+    res = (res == 1) ? fread(&best_parameters_size, sizeof(uint64_t), 1, file) : res;
+
+    if (res != 1) {
+        perror("fread() failed at trainingcontext_load()");
         return EXIT_FAILURE;
     }
+    context->schedule = (LearningRateSchedule)schedule;
+
+    if (best_parameters_size > 0) {
+        context->best_parameters = (uint8_t *)malloc(best_parameters_size);
+        if (!context->best_parameters || fread(context->best_parameters, best_parameters_size, 1, file) != 1) {
+            fprintf(stderr, "ERROR: Failed to read the best parameters at trainingcontext_load()\n");
+            free(context->best_parameters);
+            context->best_parameters = NULL;
+            return EXIT_FAILURE;
+        }
+        context->best_parameters_size = best_parameters_size;
+    }
 
     return EXIT_SUCCESS;
+}
+
+// The plateau schedule lowers learning_rate itself in neuralnetwork_train()
+double trainingcontext_learning_rate(TrainingContext *context) {
+    double progress = context->epoch;
+    if (context->schedule_every_examples > 0 && context->number_of_examples > 0) {
+        uint32_t example = context->example - context->example % context->schedule_every_examples;
+        progress += (double)example / context->number_of_examples;
+    }
+
+    double learning_rate = context->learning_rate;
+    switch (context->schedule) {
+        case STEP_SCHEDULE:
+            learning_rate *= pow(context->decay_rate, floor(progress / (context->decay_epochs > 0 ? context->decay_epochs : 1)));
+            break;
+        case EXPONENTIAL_SCHEDULE:
+            learning_rate *= pow(context->decay_rate, progress);
+            break;
+        case COSINE_SCHEDULE:
+            learning_rate = context->minimum_learning_rate + (learning_rate - context->minimum_learning_rate) * 0.5 * (1.0 + cos(M_PI * progress / context->number_of_epochs));
+            break;
+        default:
+            break;
+    }
+
+    uint64_t examples_seen = (uint64_t)context->epoch * context->number_of_examples + context->example;
+    if (examples_seen < context->warmup_examples) {
+        learning_rate *= (double)(examples_seen + 1) / context->warmup_examples;
+    }
+
+    return learning_rate;
 }
\ No newline at end of file
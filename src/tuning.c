@@ -0,0 +1,302 @@
+#include "tuning.h"
+
+#include <assert.h>
+#include <omp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "random.h"
+
+#define TUNING_KEY_LENGTH 256
+#define TUNING_LINE_LENGTH 768
+#define TUNING_MIN_SECONDS 0.02
+#define TUNING_MIN_REPETITIONS 3
+#define TUNING_BATCH_SIZE 1024
+#define TUNING_SEED 42
+
+static const uint32_t tile_size_candidates[] = {4, 8, 16, 32, 64};
+#define NUMBER_OF_TILE_SIZE_CANDIDATES (sizeof(tile_size_candidates) / sizeof(tile_size_candidates[0]))
+
+typedef enum tuningkernel {
+    FORWARD_KERNEL,
+    BACKWARD_KERNEL,
+    TILE_KERNEL,
+    BATCH_KERNEL,
+} TuningKernel;
+
+typedef struct tuningbenchmark {
+    TuningKernel kernel;
+    NeuralNetwork *network;
+    Layer *layer;
+    double *inputs;
+    double *outputs;
+    uint32_t tile_size;
+    LayerBackwardContext backward_context;
+} TuningBenchmark;
+
+static void tuning_cpu_key(char *key, size_t size) {
+    char line[TUNING_LINE_LENGTH];
+    snprintf(key, size, "unknown");
+
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (file) {
+        while (fgets(line, sizeof(line), file)) {
+            char *value = strchr(line, ':');
+            if (strncmp(line, "model name", strlen("model name")) == 0 && value) {
+                value += strspn(value, ": \t");
+                value[strcspn(value, "\n")] = '\0';
+                snprintf(key, size, "%s", value);
+                break;
+            }
+        }
+        fclose(file);
+    }
+
+    size_t length = strlen(key);
+    // Plans never use more threads than OpenMP allows, so that limit is part of the key
+    snprintf(key + length, size - length, " x%d", omp_get_max_threads());
+}
+
+static bool tuning_cache_find(const char *cache_filename, const char *cpu_key, const char *shape_key, char *value, size_t size) {
+    FILE *file = fopen(cache_filename, "r");
+    if (!file) {
+        return false;
+    }
+
+    bool found = false;
+    char line[TUNING_LINE_LENGTH];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+        char *shape = strchr(line, ';');
+        char *plan = shape ? strchr(shape + 1, ';') : NULL;
+        if (!plan) {
+            continue;
+        }
+        *shape++ = '\0';
+        *plan++ = '\0';
+        if (strcmp(line, cpu_key) == 0 && strcmp(shape, shape_key) == 0) {
+            snprintf(value, size, "%s", plan);
+            found = true;
+        }
+    }
+
+    fclose(file);
+    return found;
+}
+
+static void tuning_cache_add(const char *cache_filename, const char *cpu_key, const char *shape_key, const char *value) {
+    FILE *file = fopen(cache_filename, "a");
+    if (!file) {
+        perror("fopen() failed at tuning_cache_add()");
+        return;
+    }
+    fprintf(file, "%s;%s;%s\n", cpu_key, shape_key, value);
+    fclose(file);
+}
+
+static void tuning_run(TuningBenchmark *benchmark) {
+    switch (benchmark->kernel) {
+        case FORWARD_KERNEL:
+            layer_forward(benchmark->layer, benchmark->inputs, benchmark->outputs);
+            return;
+        case BACKWARD_KERNEL:
+            layer_backward(benchmark->layer, &benchmark->backward_context);
+            layer_update(benchmark->layer, &benchmark->backward_context);
+            return;
+        case TILE_KERNEL:
+            layer_forward_tile(benchmark->layer, benchmark->inputs, benchmark->tile_size, benchmark->outputs);
+            return;
+        case BATCH_KERNEL:
+            neuralnetwork_forward_batch(benchmark->network, benchmark->inputs, TUNING_BATCH_SIZE, benchmark->outputs);
+            return;
+    }
+}
+
+// Average seconds per run, after a warm-up run
+static double tuning_measure(TuningBenchmark *benchmark) {
+    tuning_run(benchmark);
+
+    uint32_t repetitions = 0;
+    double start = omp_get_wtime();
+    double elapsed = 0.0;
+    while (repetitions < TUNING_MIN_REPETITIONS || elapsed < TUNING_MIN_SECONDS) {
+        tuning_run(benchmark);
+        repetitions++;
+        elapsed = omp_get_wtime() - start;
+    }
+    return elapsed / repetitions;
+}
+
+// Powers of two, then the maximum number of threads
+static int tuning_next_threads(int threads, int max_threads) {
+    if (threads < max_threads && threads * 2 > max_threads) {
+        return max_threads;
+    }
+    return threads * 2;
+}
+
+static int tuning_best_threads(TuningBenchmark *benchmark, int *planned_threads) {
+    int max_threads = omp_get_max_threads();
+    int best_threads = 1;
+    double best_time = 0.0;
+    for (int threads = 1; threads <= max_threads; threads = tuning_next_threads(threads, max_threads)) {
+        *planned_threads = threads;
+        double time = tuning_measure(benchmark);
+        if (threads == 1 || time < best_time) {
+            best_threads = threads;
+            best_time = time;
+        }
+    }
+    *planned_threads = best_threads;
+    return best_threads;
+}
+
+// A hidden layer (next_layer != NULL) is benchmarked on its backpropagation through the layer above
+static void tuning_layer(Layer *layer, Layer *next_layer, TuningBenchmark *benchmark) {
+    benchmark->layer = layer;
+
+    benchmark->kernel = FORWARD_KERNEL;
+    tuning_best_threads(benchmark, &layer->plan.forward_threads);
+
+    // A zero learning rate leaves the weights unchanged
+    benchmark->kernel = BACKWARD_KERNEL;
+    benchmark->backward_context = (LayerBackwardContext){
+        .hidden_layer = (next_layer != NULL),
+        .learning_rate = 0.0,
+        .label = 0,
+        .input = benchmark->inputs,
+        .output = benchmark->outputs,
+        .layer_errors = &benchmark->outputs[layer->output_size],
+        .next_layer_output_size = next_layer ? next_layer->output_size : 0,
+        .next_layer_weights = next_layer ? next_layer->weights : NULL,
+        .next_layer_errors = next_layer ? benchmark->inputs : NULL,
+    };
+    tuning_best_threads(benchmark, &layer->plan.backward_threads);
+}
+
+static void tuning_tile_block(Layer *layer, TuningBenchmark *benchmark) {
+    benchmark->kernel = TILE_KERNEL;
+    benchmark->layer = layer;
+    layer->plan.tile_block = 1;
+    double single_time = tuning_measure(benchmark);
+    layer->plan.tile_block = LAYER_TILE_BLOCK;
+    double block_time = tuning_measure(benchmark);
+    layer->plan.tile_block = (single_time < block_time) ? 1 : LAYER_TILE_BLOCK;
+}
+
+// The best tile block of a layer depends on the tile size, so they are tuned together
+static void tuning_network(NeuralNetwork *network, TuningBenchmark *benchmark) {
+    benchmark->network = network;
+
+    uint32_t *best_tile_blocks = (uint32_t *)malloc(network->layers_size * sizeof(uint32_t));
+    if (!best_tile_blocks) {
+        fprintf(stderr, "ERROR: malloc() failed at tuning_network()\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t best_tile_size = FORWARD_TILE_SIZE;
+    double best_time = 0.0;
+    for (uint32_t i = 0; i < NUMBER_OF_TILE_SIZE_CANDIDATES; i++) {
+        network->tile_size = tile_size_candidates[i];
+        benchmark->tile_size = tile_size_candidates[i];
+        for (uint16_t l = 0; l < network->layers_size; l++) {
+            tuning_tile_block(&network->layers[l], benchmark);
+        }
+
+        benchmark->kernel = BATCH_KERNEL;
+        double time = tuning_measure(benchmark);
+        if (i == 0 || time < best_time) {
+            best_tile_size = tile_size_candidates[i];
+            best_time = time;
+            for (uint16_t l = 0; l < network->layers_size; l++) {
+                best_tile_blocks[l] = network->layers[l].plan.tile_block;
+            }
+        }
+    }
+
+    network->tile_size = best_tile_size;
+    for (uint16_t l = 0; l < network->layers_size; l++) {
+        network->layers[l].plan.tile_block = best_tile_blocks[l];
+    }
+    free(best_tile_blocks);
+}
+
+// Network plans are the tile size followed by the tile block of each layer
+static void tuning_parse_network(NeuralNetwork *network, const char *value) {
+    char *end;
+    network->tile_size = (uint32_t)strtoul(value, &end, 10);
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        network->layers[i].plan.tile_block = (uint32_t)strtoul(end, &end, 10);
+    }
+}
+
+void neuralnetwork_autotune(NeuralNetwork *network, const char *cache_filename) {
+    assert(network->layers_size == network->layers_capacity);
+
+    char cpu_key[TUNING_KEY_LENGTH];
+    char shape_key[TUNING_KEY_LENGTH];
+    char value[TUNING_KEY_LENGTH];
+    tuning_cpu_key(cpu_key, sizeof(cpu_key));
+
+    // Benchmark buffers, sized for the widest layer and the batched forward
+    uint32_t max_size = 0;
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        max_size = (network->layers[i].input_size > max_size) ? network->layers[i].input_size : max_size;
+        max_size = (network->layers[i].output_size > max_size) ? network->layers[i].output_size : max_size;
+    }
+    size_t buffer_size = sizeof(double) * TUNING_BATCH_SIZE * max_size;
+    Arena arena = arena_create(2 * arena_aligned_size(buffer_size));
+    TuningBenchmark benchmark = {
+        .inputs = (double *)arena_allocate(&arena, buffer_size),
+        .outputs = (double *)arena_allocate(&arena, buffer_size),
+    };
+    RandomStream stream = random_stream(TUNING_SEED, 0);
+    for (size_t i = 0; i < (size_t)TUNING_BATCH_SIZE * max_size; i++) {
+        benchmark.inputs[i] = random_uniform(&stream, i, 0.0, 1.0);
+    }
+
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        Layer *layer = &network->layers[i];
+        snprintf(shape_key, sizeof(shape_key), "layer %dx%d activation %d", layer->input_size, layer->output_size, layer->activation_function);
+
+        if (tuning_cache_find(cache_filename, cpu_key, shape_key, value, sizeof(value)) &&
+            sscanf(value, "%d %d", &layer->plan.forward_threads, &layer->plan.backward_threads) == 2) {
+            continue;
+        }
+
+        tuning_layer(layer, (i + 1 < network->layers_size) ? &network->layers[i + 1] : NULL, &benchmark);
+        snprintf(value, sizeof(value), "%d %d", layer->plan.forward_threads, layer->plan.backward_threads);
+        tuning_cache_add(cache_filename, cpu_key, shape_key, value);
+    }
+
+    int length = snprintf(shape_key, sizeof(shape_key), "network %d", neuralnetwork_input_size(network));
+    for (uint16_t i = 0; i < network->layers_size && length < (int)sizeof(shape_key); i++) {
+        length += snprintf(shape_key + length, sizeof(shape_key) - length, "-%d", network->layers[i].output_size);
+    }
+    if (tuning_cache_find(cache_filename, cpu_key, shape_key, value, sizeof(value))) {
+        tuning_parse_network(network, value);
+    } else {
+        tuning_network(network, &benchmark);
+        length = snprintf(value, sizeof(value), "%u", network->tile_size);
+        for (uint16_t i = 0; i < network->layers_size && length < (int)sizeof(value); i++) {
+            length += snprintf(value + length, sizeof(value) - length, " %u", network->layers[i].plan.tile_block);
+        }
+        tuning_cache_add(cache_filename, cpu_key, shape_key, value);
+    }
+
+    printf("Autotuned plan for '%s':\n", cpu_key);
+    for (uint16_t i = 0; i < network->layers_size; i++) {
+        Layer *layer = &network->layers[i];
+        printf("   layer %dx%d: forward on %d threads, backward on %d threads, tile block %d\n", layer->input_size, layer->output_size, layer->plan.forward_threads, layer->plan.backward_threads, layer->plan.tile_block);
+    }
+    printf("   batched forward tile size: %d\n", network->tile_size);
+
+    arena_destroy(&arena);
+
+    // The weights were first touched before the plans changed
+    neuralnetwork_place(network);
+}
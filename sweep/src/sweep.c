@@ -0,0 +1,135 @@
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "data.h"
+#include "memory.h"
+#include "neuralnetwork.h"
+
+#define RANDOM_SEED 42
+#define NUMBER_OF_IMAGES_VALIDATION 5000
+#define PATIENCE 2
+
+static const double learning_rates[] = {0.05, 0.10, 0.20};
+static const uint32_t numbers_of_epochs[] = {3, 5};
+static const uint32_t hidden_sizes[] = {32, 64, 89, 128};
+
+#define NUMBER_OF_LEARNING_RATES (sizeof(learning_rates) / sizeof(learning_rates[0]))
+#define NUMBER_OF_NUMBERS_OF_EPOCHS (sizeof(numbers_of_epochs) / sizeof(numbers_of_epochs[0]))
+#define NUMBER_OF_HIDDEN_SIZES (sizeof(hidden_sizes) / sizeof(hidden_sizes[0]))
+#define NUMBER_OF_CONFIGURATIONS (NUMBER_OF_LEARNING_RATES * NUMBER_OF_NUMBERS_OF_EPOCHS * NUMBER_OF_HIDDEN_SIZES)
+
+typedef struct configuration {
+    double learning_rate;
+    uint32_t number_of_epochs;
+    uint32_t hidden_size;
+
+    uint32_t epochs_run;
+    double accuracy;
+    double seconds;
+    double samples_per_second;
+} Configuration;
+
+static void configuration_run(Configuration *configuration, Dataset *train, Dataset *test) {
+    uint32_t number_of_examples = train->number_of_images - NUMBER_OF_IMAGES_VALIDATION;
+
+    NeuralNetwork network = neuralnetwork_create(2);
+    neuralnetwork_add_layer(&network, train->image_size, SIGMOID_ACTIVATION, configuration->hidden_size);
+    neuralnetwork_add_layer(&network, configuration->hidden_size, SOFTMAX_ACTIVATION, train->number_of_classes);
+    neuralnetwork_initialize(&network, XAVIER_INITIALIZATION, RANDOM_SEED);
+
+    TrainingContext context = {
+        .learning_rate = configuration->learning_rate,
+        .number_of_epochs = configuration->number_of_epochs,
+        .number_of_examples = number_of_examples,
+        .validation_inputs = &train->images[(size_t)number_of_examples * train->image_size],
+        .validation_labels = &train->labels[number_of_examples],
+        .number_of_validation_examples = NUMBER_OF_IMAGES_VALIDATION,
+        .patience = PATIENCE,
+        .quiet = true,
+    };
+
+    double start = omp_get_wtime();
+    neuralnetwork_train(&network, train->images, train->labels, &context);
+    configuration->seconds = omp_get_wtime() - start;
+
+    configuration->epochs_run = context.epoch;
+    configuration->samples_per_second = (double)context.epoch * number_of_examples / configuration->seconds;
+    configuration->accuracy = neuralnetwork_benchmark(&network, test->images, test->labels, test->number_of_images);
+
+    neuralnetwork_destroy(&network);
+}
+
+static void print_results(Configuration *configurations, uint32_t number_of_configurations, FILE *file, const char *separator) {
+    fprintf(file, "learning_rate%sepochs%shidden_size%sepochs_run%saccuracy%sseconds%ssamples_per_second\n", separator, separator, separator, separator, separator, separator);
+    for (uint32_t i = 0; i < number_of_configurations; i++) {
+        Configuration *c = &configurations[i];
+        fprintf(file, "%.3f%s%d%s%d%s%d%s%.4f%s%.2f%s%.1f\n", c->learning_rate, separator, c->number_of_epochs, separator, c->hidden_size, separator, c->epochs_run, separator, c->accuracy, separator, c->seconds, separator, c->samples_per_second);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s DATA_DIRECTORY [RESULTS_CSV] [THREADS_PER_MODEL]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char *results_filename = (argc > 2) ? argv[2] : "sweep.csv";
+    int threads_per_model = (argc > 3) ? atoi(argv[3]) : 1;
+    if (threads_per_model < 1) {
+        threads_per_model = 1;
+    }
+
+    // The dataset is loaded and normalized once, then only read by every training
+    Dataset train = dataset_load(argv[1], "train");
+    Dataset test = dataset_load(argv[1], "test");
+    if (train.number_of_images <= NUMBER_OF_IMAGES_VALIDATION) {
+        fprintf(stderr, "ERROR: Not enough training images (%d)\n", train.number_of_images);
+        exit(EXIT_FAILURE);
+    }
+
+    Configuration configurations[NUMBER_OF_CONFIGURATIONS];
+    uint32_t number_of_configurations = 0;
+    for (uint32_t i = 0; i < NUMBER_OF_HIDDEN_SIZES; i++) {
+        for (uint32_t j = 0; j < NUMBER_OF_NUMBERS_OF_EPOCHS; j++) {
+            for (uint32_t k = 0; k < NUMBER_OF_LEARNING_RATES; k++) {
+                configurations[number_of_configurations++] = (Configuration){
+                    .learning_rate = learning_rates[k],
+                    .number_of_epochs = numbers_of_epochs[j],
+                    .hidden_size = hidden_sizes[i],
+                };
+            }
+        }
+    }
+
+    // One model per group of threads_per_model cores
+    int number_of_groups = omp_get_num_procs() / threads_per_model;
+    number_of_groups = (number_of_groups < 1) ? 1 : number_of_groups;
+    omp_set_max_active_levels(threads_per_model > 1 ? 2 : 1);
+    printf("Running %d configurations, %d at a time with %d threads each...\n", number_of_configurations, number_of_groups, threads_per_model);
+
+    double start = omp_get_wtime();
+#pragma omp parallel for schedule(dynamic, 1) num_threads(number_of_groups)
+    for (uint32_t i = 0; i < number_of_configurations; i++) {
+        omp_set_num_threads(threads_per_model);
+        configuration_run(&configurations[i], &train, &test);
+#pragma omp critical
+        printf("   [%d/%d] learning rate %.3f, %d epochs, hidden size %d: accuracy %.4f\n", i + 1, number_of_configurations, configurations[i].learning_rate, configurations[i].number_of_epochs, configurations[i].hidden_size, configurations[i].accuracy);
+    }
+    printf("Sweep done in %.2f s\n\n", omp_get_wtime() - start);
+
+    print_results(configurations, number_of_configurations, stdout, "\t");
+    FILE *file = fopen(results_filename, "w");
+    if (!file) {
+        perror("fopen() failed at main()");
+        exit(EXIT_FAILURE);
+    }
+    print_results(configurations, number_of_configurations, file, ",");
+    fclose(file);
+    printf("\nResults saved to '%s'\n", results_filename);
+
+    dataset_destroy(&train);
+    dataset_destroy(&test);
+    return EXIT_SUCCESS;
+}